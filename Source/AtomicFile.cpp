@@ -0,0 +1,159 @@
+#include "AtomicFile.h"
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+static std::wstring Widen(const std::string& path) {
+    int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+    std::wstring wide(length > 0 ? length - 1 : 0, L'\0');
+    if (length > 1) MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wide[0], length);
+    return wide;
+}
+#endif
+
+AtomicFile::~AtomicFile() {
+    Close();
+    if (!committed && !tempPath.empty()) {
+#ifdef _WIN32
+        DeleteFileW(Widen(tempPath).c_str());
+#else
+        unlink(tempPath.c_str());
+#endif
+    }
+}
+
+void AtomicFile::Close() {
+    if (handle == -1) return;
+#ifdef _WIN32
+    CloseHandle((HANDLE)handle);
+#else
+    close((int)handle);
+#endif
+    handle = -1;
+}
+
+bool AtomicFile::Open(const std::string& destination, std::string& error) {
+    path = destination;
+#ifdef _WIN32
+    tempPath = path + "." + std::to_string(GetCurrentProcessId()) + ".tmp";
+    HANDLE file = CreateFileW(Widen(tempPath).c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) { tempPath.clear(); error = "Could not create file"; return false; }
+    handle = (intptr_t)file;
+#else
+    tempPath = path + "." + std::to_string(getpid()) + ".tmp";
+    int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0) { tempPath.clear(); error = "Could not create file"; return false; }
+    // Keep the permissions of the file being replaced.
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0) fchmod(fd, info.st_mode & 07777);
+    handle = fd;
+#endif
+    return true;
+}
+
+bool AtomicFile::Write(const char* data, size_t length) {
+    if (handle == -1 || !failure.empty()) return false;
+    if (length == 0) return true;
+    if (!pending.empty() && pending.back().data + pending.back().length == data) {
+        pending.back().length += length;
+    }
+    else {
+        if (pending.size() == MaxSpans && !Flush()) return false;
+        pending.push_back(Span{ data, length });
+    }
+    return true;
+}
+
+bool AtomicFile::Flush() {
+#ifdef _WIN32
+    for (const Span& span : pending) {
+        for (size_t offset = 0; offset < span.length;) {
+            DWORD count = (DWORD)std::min<size_t>(span.length - offset, 1u << 30);
+            DWORD written = 0;
+            if (!WriteFile((HANDLE)handle, span.data + offset, count, &written, nullptr) || written == 0) {
+                failure = "Could not write file";
+                return false;
+            }
+            offset += written;
+        }
+    }
+#else
+    std::vector<iovec> vectors(pending.size());
+    for (size_t i = 0; i < pending.size(); i++) vectors[i] = iovec{ (void*)pending[i].data, pending[i].length };
+    size_t first = 0;
+    while (first < vectors.size()) {
+        ssize_t written = writev((int)handle, &vectors[first], (int)(vectors.size() - first));
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) { failure = "Could not write file"; return false; }
+        // Skip what was written; a short write leaves the rest of a vector for the next call.
+        size_t remaining = (size_t)written;
+        while (first < vectors.size() && remaining >= vectors[first].iov_len) remaining -= vectors[first++].iov_len;
+        if (remaining > 0) {
+            vectors[first].iov_base = (char*)vectors[first].iov_base + remaining;
+            vectors[first].iov_len -= remaining;
+        }
+    }
+#endif
+    pending.clear();
+    return true;
+}
+
+bool AtomicFile::Finish(std::string& error) {
+    if (handle == -1) { error = failure.empty() ? "File is not open" : failure; return false; }
+    bool flushed = failure.empty() && Flush();
+#ifdef _WIN32
+    if (flushed && !FlushFileBuffers((HANDLE)handle)) failure = "Could not flush file to disk";
+#else
+    if (flushed && fsync((int)handle) != 0) failure = "Could not flush file to disk";
+#endif
+    Close();
+    if (!failure.empty()) { error = failure; return false; }
+    return true;
+}
+
+bool AtomicFile::Commit(std::string& error) {
+    if (handle != -1 || tempPath.empty() || !failure.empty()) { error = "File was not finished"; return false; }
+#ifdef _WIN32
+    std::wstring from = Widen(tempPath), to = Widen(path);
+    if (!MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        // Each save needs a new name: an aside file still mapped lingers until unmapped.
+        static unsigned asideCount = 0;
+        std::wstring aside = Widen(path + "." + std::to_string(GetCurrentProcessId()) + "." +
+            std::to_string(++asideCount) + ".old");
+        if (!MoveFileExW(to.c_str(), aside.c_str(), MOVEFILE_WRITE_THROUGH)) {
+            error = "Could not replace file";
+            return false;
+        }
+        if (!MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_WRITE_THROUGH)) {
+            MoveFileExW(aside.c_str(), to.c_str(), MOVEFILE_WRITE_THROUGH);
+            error = "Could not replace file";
+            return false;
+        }
+        DeleteFileW(aside.c_str());
+    }
+#else
+    if (rename(tempPath.c_str(), path.c_str()) != 0) { error = "Could not replace file"; return false; }
+    // Make the rename itself durable.
+    size_t slash = path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int fd = open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+#endif
+    committed = true;
+    return true;
+}
@@ -0,0 +1,804 @@
+#include "Benchmark.h"
+#include "EditorView.h"
+#include "FileLoader.h"
+#include "FileSearch.h"
+#include "IncrementalFind.h"
+#include "PieceTable.h"
+#include "Regex.h"
+#include "TextKernels.h"
+#include "TextSearch.h"
+#include "UndoHistory.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <imgui.h>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double Milliseconds(Clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+}
+
+size_t PeakResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return (size_t)usage.ru_maxrss;
+#else
+    return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+double ToMiB(size_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+// The last argument that isn't an option or an option's value; empty when there is none.
+std::string PathArgument(int argc, char** argv) {
+    std::string path;
+    for (int i = 0; i < argc; i++) {
+        if (!strncmp(argv[i], "--", 2)) i++;
+        else path = argv[i];
+    }
+    return path;
+}
+
+// xorshift64 with a fixed seed, so every run sees the same sequence.
+class Random {
+public:
+    uint64_t Next() {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        return seed;
+    }
+
+private:
+    uint64_t seed = 88172645463325252ull;
+};
+
+// About 1 MiB of log-like lines, repeated to build test documents.
+const std::string& LogBlock() {
+    static std::string block;
+    for (int i = 0; block.size() < 1024 * 1024; i++) {
+        block += "2024-05-17 12:34:56.789 INFO  worker-" + std::to_string(i % 64) +
+            " request handled status=200 bytes=" + std::to_string(i * 37 % 100000) + " path=/api/v1/items\n";
+    }
+    return block;
+}
+
+std::string MakeLogText(size_t bytes) {
+    const std::string& block = LogBlock();
+    std::string text;
+    text.reserve(bytes);
+    while (text.size() < bytes) text.append(block, 0, std::min(block.size(), bytes - text.size()));
+    return text;
+}
+
+// Paragraphs of random words, one per line, as in prose written without hard wraps.
+std::string MakeProseText(size_t bytes) {
+    static const char* const words[] = { "the", "editor", "wraps", "long", "paragraphs", "of", "text", "at",
+        "window", "width", "and", "keeps", "scrolling", "smooth", "while", "it", "measures", "lines", "in",
+        "background", "a", "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "with", "some", "words" };
+    const size_t wordCount = sizeof(words) / sizeof(words[0]);
+    Random random;
+    std::string text;
+    text.reserve(bytes + 4096);
+    while (text.size() < bytes) {
+        size_t length = 40 + random.Next() % 160;
+        for (size_t i = 0; i < length; i++) {
+            if (i) text += ' ';
+            text += words[random.Next() % wordCount];
+        }
+        text += ".\n";
+    }
+    return text;
+}
+
+// ImGui without a backend: frames build draw lists that are never rendered.
+void CreateHeadlessContext(const ImVec2& displaySize) {
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = displaySize;
+    io.DeltaTime = 1.0f / 60.0f;
+    io.IniFilename = nullptr;
+    io.Fonts->AddFontDefault();
+    unsigned char* pixels;
+    int width, height;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+}
+
+// One frame with the view filling a window of the given size; returns its time in ms.
+double RenderViewFrame(EditorView& view, const PieceTable& document, const ImVec2& size) {
+    static const EditorView::EditHandler readOnly = [](size_t, size_t, const std::string&, bool) { return false; };
+    Clock::time_point start = Clock::now();
+    ImGui::NewFrame();
+    ImGui::SetNextWindowPos(ImVec2(0, 0));
+    ImGui::SetNextWindowSize(size);
+    ImGui::Begin("Editor", nullptr, ImGuiWindowFlags_NoDecoration);
+    view.Render("##text", document, ImGui::GetContentRegionAvail(), true, readOnly);
+    ImGui::End();
+    ImGui::Render();
+    return Milliseconds(start);
+}
+
+
+// Average nanoseconds per call of fn over iterations calls.
+template <typename Fn>
+double NanosecondsPerCall(size_t iterations, Fn&& fn) {
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < iterations; i++) fn(i);
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+}
+
+// Opens path with FileLoader the way the editor does, polling once per simulated frame.
+// Reports when the first batch reached the document (first paint) and when it finished.
+bool TimeBackgroundLoad(const std::string& path, double& firstPaintMs, double& totalMs) {
+    FileLoader loader;
+    PieceTable document;
+    Clock::time_point start = Clock::now();
+    loader.Start(path, PieceTable::Unlimited);
+    firstPaintMs = -1;
+    for (;;) {
+        FileLoader::Update update;
+        if (loader.Poll(update)) {
+            if (update.file) document.BeginLoad(update.file);
+            for (const FileLoader::Batch& batch : update.batches) document.AppendLoaded(batch.pieces);
+            if (firstPaintMs < 0 && !update.batches.empty()) firstPaintMs = Milliseconds(start);
+            if (update.finished) {
+                totalMs = Milliseconds(start);
+                return update.error.empty();
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+// load [file] [--size-mb N]: time PieceTable::LoadFile and the background loader, and
+// report peak RSS.
+int BenchLoad(int argc, char** argv) {
+    std::string path = PathArgument(argc, argv);
+    size_t sizeMiB = OptionValue(argc, argv, "--size-mb", 2048);
+    bool generated = path.empty();
+    if (generated) {
+        path = "texteditor-bench-load.txt";
+        printf("Generating %zu MiB test file %s...\n", sizeMiB, path.c_str());
+        if (!GenerateLogFile(path, sizeMiB)) { fprintf(stderr, "Could not write %s\n", path.c_str()); return 1; }
+    }
+
+    size_t rssBefore = PeakResidentBytes();
+    PieceTable document;
+    std::string error;
+    Clock::time_point start = Clock::now();
+    bool loaded = document.LoadFile(path, error);
+    double loadMs = Milliseconds(start);
+    if (!loaded) { fprintf(stderr, "Load failed: %s\n", error.c_str()); return 1; }
+
+    start = Clock::now();
+    size_t line, column;
+    document.LineColumn(document.Size() / 2, line, column);
+    double lookupMs = Milliseconds(start);
+
+    printf("size        %.1f MiB\n", ToMiB(document.Size()));
+    printf("lines       %zu\n", document.LineCount());
+    printf("load        %.1f ms (%.2f GiB/s)\n", loadMs, document.Size() / (loadMs / 1000.0) / (1024.0 * 1024.0 * 1024.0));
+    printf("line lookup %.3f ms\n", lookupMs);
+    printf("mapped      %s\n", document.IsMapped() ? "yes" : "no (read into memory)");
+    printf("heap buffer %.1f MiB\n", ToMiB(document.MemoryUsed()));
+    printf("peak RSS    %.1f MiB (%.1f MiB before load)\n", ToMiB(PeakResidentBytes()), ToMiB(rssBefore));
+
+    double firstPaintMs, totalMs;
+    if (TimeBackgroundLoad(path, firstPaintMs, totalMs)) {
+        printf("background  first paint %.1f ms, complete %.1f ms\n", firstPaintMs, totalMs);
+    }
+
+    if (generated) std::remove(path.c_str());
+    return 0;
+}
+
+// save [--size-mb N]: PieceTable::SaveFile on an edited, memory-mapped document next to
+// the old approach of flattening the text and streaming it through std::ofstream.
+int BenchSave(int argc, char** argv) {
+    size_t sizeMiB = OptionValue(argc, argv, "--size-mb", 1024);
+
+    std::string source = "texteditor-bench-save-source.txt";
+    std::string target = "texteditor-bench-save.txt";
+    printf("Generating %zu MiB test file %s...\n", sizeMiB, source.c_str());
+    if (!GenerateLogFile(source, sizeMiB)) { fprintf(stderr, "Could not write %s\n", source.c_str()); return 1; }
+
+    PieceTable document;
+    std::string error;
+    if (!document.LoadFile(source, error)) { fprintf(stderr, "Load failed: %s\n", error.c_str()); return 1; }
+    Random random;
+    for (int i = 0; i < 1000; i++) document.Insert(random.Next() % document.Size(), "edit ", 5);
+    double mib = ToMiB(document.Size());
+
+    Clock::time_point start = Clock::now();
+    bool saved = document.SaveFile(target, error);
+    double saveMs = Milliseconds(start);
+    if (!saved) { fprintf(stderr, "Save failed: %s\n", error.c_str()); return 1; }
+
+    start = Clock::now();
+    {
+        std::ofstream file(target, std::ios::binary);
+        file << document.ToString();
+    }
+    double streamMs = Milliseconds(start);
+
+    printf("size        %.1f MiB in %zu pieces\n", mib, document.Pieces().PieceCount());
+    printf("atomic save %.1f ms (%.0f MiB/s, including fsync)\n", saveMs, mib / (saveMs / 1000.0));
+    printf("ofstream    %.1f ms (%.0f MiB/s, no fsync)\n", streamMs, mib / (streamMs / 1000.0));
+
+    std::remove(source.c_str());
+    std::remove(target.c_str());
+    return 0;
+}
+
+// Applies an undo (direction < 0) or redo step the way the editor does.
+void ApplyStep(PieceTable& document, const UndoHistory::Step& step, int direction) {
+    document.Erase(step.offset, direction < 0 ? step.insertedBytes : step.removedBytes);
+    document.InsertPieces(step.offset, direction < 0 ? step.removed : step.inserted);
+}
+
+// undo [--max-mb N]: undo/redo of a 10 MiB replace, and the history cost of 10,000
+// keystrokes, against document size.
+int BenchUndo(int argc, char** argv) {
+    size_t maxMiB = OptionValue(argc, argv, "--max-mb", 1024);
+
+    const size_t replaceBytes = 10 * 1024 * 1024;
+    const std::string replacement = MakeLogText(replaceBytes);
+    printf("%12s %12s %12s %12s %14s %16s\n", "size", "replace ms", "undo ms", "redo ms", "10k keys steps", "10k keys history");
+    for (size_t mib = 16; mib <= maxMiB; mib *= 4) {
+        PieceTable document;
+        document.Load(MakeLogText(mib * 1024 * 1024));
+        UndoHistory history;
+
+        size_t pos = document.Size() / 3;
+        Clock::time_point start = Clock::now();
+        std::vector<Piece> removed = document.PiecesIn(pos, replaceBytes);
+        document.Insert(pos + replaceBytes, replacement);
+        document.Erase(pos, replaceBytes);
+        history.Record(pos, std::move(removed), document.PiecesIn(pos, replacement.size()), false);
+        double replaceMs = Milliseconds(start);
+
+        start = Clock::now();
+        ApplyStep(document, *history.Undo(), -1);
+        double undoMs = Milliseconds(start);
+        start = Clock::now();
+        ApplyStep(document, *history.Redo(), 1);
+        double redoMs = Milliseconds(start);
+
+        // Keystrokes in lines of 60 characters; each line ends a typing run.
+        history.Clear();
+        pos = document.Size() / 2;
+        size_t steps = 0;
+        for (int i = 0; i < 10000; i++) {
+            char key = i % 60 == 59 ? '\n' : 'a' + i % 26;
+            document.Insert(pos, &key, 1);
+            history.Record(pos, {}, document.PiecesIn(pos, 1), true);
+            pos++;
+        }
+        while (history.Undo()) steps++;
+
+        printf("%10zu M %12.3f %12.3f %12.3f %14zu %12.1f KiB\n", mib, replaceMs, undoMs, redoMs, steps, history.MemoryUsed() / 1024.0);
+    }
+    return 0;
+}
+
+// replace [--size-mb N]: Replace All of a word found on every line of a log document, as
+// one ReplaceRanges pass recorded as one history step, then its undo and redo, with a
+// full read of the result for scale.
+int BenchReplace(int argc, char** argv) {
+    size_t sizeMiB = OptionValue(argc, argv, "--size-mb", 1024);
+
+    PieceTable document;
+    document.Load(MakeLogText(sizeMiB * 1024 * 1024));
+    UndoHistory history;
+    const std::string needle = "handled";
+    const std::string replacement = "served";
+    size_t piecesBefore = document.Pieces().PieceCount();
+
+    Clock::time_point start = Clock::now();
+    std::vector<std::pair<size_t, size_t>> ranges;
+    TextSearch::ForEachMatch(document, needle, 0, document.Size(), [&](size_t match) {
+        ranges.emplace_back(match, needle.size());
+        return true;
+    });
+    double findMs = Milliseconds(start);
+
+    start = Clock::now();
+    size_t pos = ranges.front().first;
+    size_t removedBytes = ranges.back().first + ranges.back().second - pos;
+    size_t insertedBytes = removedBytes - ranges.size() * needle.size() + ranges.size() * replacement.size();
+    std::vector<Piece> removed = document.PiecesIn(pos, removedBytes);
+    document.ReplaceRanges(ranges, replacement.data(), replacement.size());
+    history.Record(pos, std::move(removed), document.PiecesIn(pos, insertedBytes), false);
+    double replaceMs = Milliseconds(start);
+
+    start = Clock::now();
+    std::vector<char> copy(document.Size());
+    document.Read(0, document.Size(), copy.data());
+    double readMs = Milliseconds(start);
+
+    start = Clock::now();
+    ApplyStep(document, *history.Undo(), -1);
+    double undoMs = Milliseconds(start);
+    start = Clock::now();
+    ApplyStep(document, *history.Redo(), 1);
+    double redoMs = Milliseconds(start);
+
+    printf("%zu MiB, %zu matches\n", sizeMiB, ranges.size());
+    printf("find      %10.1f ms\n", findMs);
+    printf("replace   %10.1f ms  (pieces %zu -> %zu, memory %.1f MiB)\n", replaceMs, piecesBefore,
+        document.Pieces().PieceCount(), ToMiB(document.MemoryUsed()));
+    printf("read      %10.1f ms  (one copy of the result)\n", readMs);
+    printf("undo      %10.1f ms\n", undoMs);
+    printf("redo      %10.1f ms  (history %.1f MiB)\n", redoMs, ToMiB(history.MemoryUsed()));
+    return 0;
+}
+
+// lines [--max-mb N]: per-frame cursor/line lookups and single-character edits against
+// document size, next to the full newline scan the editor used to do every frame.
+int BenchLines(int argc, char** argv) {
+    size_t maxMiB = OptionValue(argc, argv, "--max-mb", 1024);
+
+    printf("%12s %14s %14s %14s %16s\n", "size", "line/col ns", "goto line ns", "edit ns", "full scan ms");
+    for (size_t bytes = 1024; bytes <= maxMiB * 1024 * 1024; bytes *= 32) {
+        PieceTable document;
+        document.Load(MakeLogText(bytes));
+        size_t lines = document.LineCount();
+        Random random;
+
+        volatile size_t sink = 0;
+        double lineColumn = NanosecondsPerCall(100000, [&](size_t) {
+            size_t line, column;
+            document.LineColumn(random.Next() % document.Size(), line, column);
+            sink = sink + line + column;
+        });
+        double gotoLine = NanosecondsPerCall(100000, [&](size_t) { sink = sink + document.LineStart(random.Next() % lines); });
+        double edit = NanosecondsPerCall(20000, [&](size_t i) {
+            size_t pos = random.Next() % document.Size();
+            if (i % 2 == 0) document.Insert(pos, "x", 1);
+            else document.Erase(pos, 1);
+        });
+        Clock::time_point start = Clock::now();
+        document.ForEachSpan([&](const char* data, size_t length) {
+            sink = sink + (size_t)std::count(data, data + length, '\n');
+            return true;
+        });
+        double scan = Milliseconds(start);
+        printf("%10.1f K %14.0f %14.0f %14.0f %16.3f\n", bytes / 1024.0, lineColumn, gotoLine, edit, scan);
+    }
+    return 0;
+}
+
+// view [--max-lines N]: frame time of the editor view scrolled to random places, from a
+// short document up to one of N lines. ImGui runs without a backend, so this measures
+// layout and draw-list generation but not the GPU. The generated text repeats one block
+// of lines, so after the first frames nearly every line is a layout cache hit.
+int BenchView(int argc, char** argv) {
+    size_t maxLines = OptionValue(argc, argv, "--max-lines", 50000000);
+
+    // One block of lines, repeated by reference: large documents cost pieces, not bytes.
+    const size_t blockLines = 64;
+    std::string block;
+    char line[64];
+    for (size_t i = 0; i < blockLines; i++) {
+        snprintf(line, sizeof(line), "%02zu the quick brown fox jumps over the lazy dog\n", i);
+        block += line;
+    }
+
+    CreateHeadlessContext(ImVec2(1200, 800));
+    printf("%12s %12s %12s %14s\n", "lines", "mean ms", "max ms", "layout hits");
+    const size_t sizes[] = { 100, 10000, 1000000, maxLines };
+    for (size_t lines : sizes) {
+        if (lines > maxLines) continue;
+        PieceTable document;
+        document.Load(block);
+        std::vector<Piece> pieces = document.PiecesIn(0, document.Size());
+        std::vector<Piece> repeated;
+        for (size_t n = blockLines; n < lines; n += blockLines) repeated.insert(repeated.end(), pieces.begin(), pieces.end());
+        document.AppendLoaded(repeated);
+
+        EditorView view;
+        Random random;
+        const int frames = 300;
+        double total = 0, worst = 0;
+        for (int frame = 0; frame < frames; frame++) {
+            view.SetTopLine(random.Next() % document.LineCount());
+            double ms = RenderViewFrame(view, document, ImGui::GetIO().DisplaySize);
+            total += ms;
+            worst = std::max(worst, ms);
+        }
+        const LayoutCache& layouts = view.Layouts();
+        double hitRate = 100.0 * layouts.Hits() / std::max<size_t>(1, layouts.Hits() + layouts.Misses());
+        printf("%12zu %12.3f %12.3f %13.1f%%\n", document.LineCount(), total / frames, worst, hitRate);
+    }
+    ImGui::DestroyContext();
+    return 0;
+}
+
+// wrap [--size-mb N]: word wrap over prose with one paragraph per line. The window is
+// dragged narrower a few pixels per frame, as a resize does, then left alone until every
+// line has been measured at the final width. No frame should take more than a few ms.
+int BenchWrap(int argc, char** argv) {
+    size_t sizeMiB = OptionValue(argc, argv, "--size-mb", 20);
+
+    PieceTable document;
+    document.Load(MakeProseText(sizeMiB * 1024 * 1024));
+    CreateHeadlessContext(ImVec2(1200, 800));
+    EditorView view;
+    view.SetWrap(true);
+    view.SetTopLine(document.LineCount() / 2);
+
+    printf("%zu MiB, %zu lines\n", sizeMiB, document.LineCount());
+    printf("%-10s %8s %10s %10s\n", "phase", "frames", "mean ms", "max ms");
+    auto report = [](const char* phase, int frames, double total, double worst) {
+        printf("%-10s %8d %10.3f %10.3f\n", phase, frames, total / std::max(frames, 1), worst);
+    };
+    const int resizeFrames = 120;
+    double total = 0, worst = 0;
+    for (int frame = 0; frame < resizeFrames; frame++) {
+        double ms = RenderViewFrame(view, document, ImVec2(1200.0f - frame * 5.0f, 800.0f));
+        total += ms;
+        worst = std::max(worst, ms);
+    }
+    report("resize", resizeFrames, total, worst);
+
+    ImVec2 finalSize(1200.0f - (resizeFrames - 1) * 5.0f, 800.0f);
+    Clock::time_point start = Clock::now();
+    int frames = 0;
+    total = worst = 0;
+    while (view.Reflowing()) {
+        double ms = RenderViewFrame(view, document, finalSize);
+        total += ms;
+        worst = std::max(worst, ms);
+        frames++;
+    }
+    report("reflow", frames, total, worst);
+    printf("fully measured after %.1f ms\n", Milliseconds(start));
+    ImGui::DestroyContext();
+    return 0;
+}
+
+// longline [--size-mb N]: one line of minified JSON, with the cursor set to random places
+// along it so every frame scrolls somewhere new, then the same wrapped. Only the segments
+// on screen are laid out, so frames should stay well under 16 ms whatever the line's length.
+int BenchLongLine(int argc, char** argv) {
+    size_t sizeMiB = OptionValue(argc, argv, "--size-mb", 100);
+
+    std::string text;
+    text.reserve(sizeMiB * 1024 * 1024 + 64);
+    for (size_t id = 0; text.size() < sizeMiB * 1024 * 1024; id++)
+        text += "{\"id\":" + std::to_string(id) + ",\"name\":\"item\",\"tags\":[\"a\",\"b\"]},";
+    PieceTable document;
+    document.Load(std::move(text));
+    CreateHeadlessContext(ImVec2(1200, 800));
+    EditorView view;
+
+    printf("%zu MiB in one line\n", sizeMiB);
+    printf("%-10s %8s %10s %10s\n", "phase", "frames", "mean ms", "max ms");
+    const int frames = 300;
+    Random random;
+    double first = RenderViewFrame(view, document, ImVec2(1200, 800));
+    double total = 0, worst = 0;
+    for (int frame = 0; frame < frames; frame++) {
+        view.SetCursor(random.Next() % document.Size());
+        double ms = RenderViewFrame(view, document, ImVec2(1200, 800));
+        total += ms;
+        worst = std::max(worst, ms);
+    }
+    printf("%-10s %8d %10.3f %10.3f\n", "open", 1, first, first);
+    printf("%-10s %8d %10.3f %10.3f\n", "jump", frames, total / frames, worst);
+
+    // Wrapped, the line's rows are counted a segment at a time as they come on screen.
+    view.SetWrap(true);
+    first = RenderViewFrame(view, document, ImVec2(1200, 800));
+    total = worst = 0;
+    for (int frame = 0; frame < frames; frame++) {
+        view.SetCursor(random.Next() % document.Size());
+        double ms = RenderViewFrame(view, document, ImVec2(1200, 800));
+        total += ms;
+        worst = std::max(worst, ms);
+    }
+    printf("%-10s %8d %10.3f %10.3f\n", "wrap", 1, first, first);
+    printf("%-10s %8d %10.3f %10.3f\n", "wrap jump", frames, total / frames, worst);
+    ImGui::DestroyContext();
+    return 0;
+}
+
+// kernels [--size-mb N]: throughput of each text kernel at every ISA level the CPU
+// supports, on a cache-resident buffer and on one far larger than the caches.
+int BenchKernels(int argc, char** argv) {
+    size_t largeMiB = OptionValue(argc, argv, "--size-mb", 512);
+
+    TextKernels::Isa detected = TextKernels::DetectedIsa();
+    printf("detected ISA: %s\n", TextKernels::IsaName(detected));
+    printf("%-9s %-10s %12s %12s %12s\n", "isa", "buffer", "newlines", "words", "nth newline");
+
+    const size_t sizes[] = { 256 * 1024, largeMiB * 1024 * 1024 };
+    for (size_t bytes : sizes) {
+        std::string text = MakeLogText(bytes);
+        size_t passes = std::max<size_t>(1, (size_t)2 * 1024 * 1024 * 1024 / bytes);
+        size_t lastLine = TextKernels::CountNewlines(text.data(), text.size());
+        for (int isa = 0; isa <= (int)detected; isa++) {
+            TextKernels::SetIsa((TextKernels::Isa)isa);
+            volatile size_t sink = 0;
+            auto gbps = [&](double nanoseconds) { return text.size() / nanoseconds; };
+            double newlines = gbps(NanosecondsPerCall(passes, [&](size_t) { sink = sink + TextKernels::CountNewlines(text.data(), text.size()); }));
+            double words = gbps(NanosecondsPerCall(passes, [&](size_t) {
+                bool inWord = false;
+                sink = sink + TextKernels::CountWordStarts(text.data(), text.size(), inWord);
+            }));
+            double nth = gbps(NanosecondsPerCall(passes, [&](size_t) { sink = sink + TextKernels::FindNthNewline(text.data(), text.size(), lastLine); }));
+            char label[32];
+            snprintf(label, sizeof(label), bytes < 1024 * 1024 ? "%zu KiB" : "%zu MiB", bytes < 1024 * 1024 ? bytes / 1024 : bytes / (1024 * 1024));
+            printf("%-9s %-10s %9.2f GB/s %7.2f GB/s %7.2f GB/s\n", TextKernels::IsaName((TextKernels::Isa)isa), label, newlines, words, nth);
+        }
+    }
+    TextKernels::SetIsa(detected);
+    return 0;
+}
+
+// find [--size-mb N]: TextSearch::FindNext over a log document for a 12-byte token that
+// only occurs at its very end, at every ISA level, plus one needle long enough for Two-Way.
+int BenchFind(int argc, char** argv) {
+    size_t sizeMiB = OptionValue(argc, argv, "--size-mb", 1024);
+
+    const std::string token = "XQZ-4821-END";
+    const std::string longToken = "request 7f3a9c1e finished with status 599 after 0 ms";
+    std::string text = MakeLogText(sizeMiB * 1024 * 1024);
+    text += token + " " + longToken + "\n";
+    PieceTable document;
+    document.Load(std::move(text));
+
+    auto run = [&](const char* label, const std::string& needle) {
+        Clock::time_point start = Clock::now();
+        size_t found = TextSearch::FindNext(document, needle, 0);
+        double ms = Milliseconds(start);
+        printf("%-9s %12zu %10.1f %10.2f\n", label, found, ms, document.Size() / (ms * 1e6));
+    };
+    printf("%zu MiB, %zu pieces\n", sizeMiB, document.Pieces().PieceCount());
+    printf("%-9s %12s %10s %10s\n", "isa", "offset", "ms", "GB/s");
+    TextKernels::Isa detected = TextKernels::DetectedIsa();
+    for (int isa = 0; isa <= (int)detected; isa++) {
+        TextKernels::SetIsa((TextKernels::Isa)isa);
+        run(TextKernels::IsaName((TextKernels::Isa)isa), token);
+    }
+    TextKernels::SetIsa(detected);
+    run("Two-Way", longToken);
+
+    // FindPrevious has to find the last occurrence, as rfind does, also for needles that
+    // overlap themselves in runs crossing its backward windows.
+    std::string periodic(3 * 1024 * 1024 + 7, 'b');
+    for (size_t i = 0; i < periodic.size(); i += 1024 * 1024 - 3) periodic[i] = 'a';
+    PieceTable runs;
+    runs.Load(periodic);
+    // Ends a whole number of windows back from the end, each a byte further on, then
+    // anywhere.
+    std::vector<size_t> probes;
+    for (size_t i = 0; i * 1024 * 1024 < periodic.size(); i++) probes.push_back(periodic.size() - i * 1024 * 1024 + i);
+    Random random;
+    for (int i = 0; i < 200; i++) probes.push_back(random.Next() % (periodic.size() + 1));
+    for (const char* needle : { "bb", "bbb", "ab", "bab" }) {
+        for (size_t before : probes) {
+            size_t expected = before == 0 ? std::string::npos : periodic.rfind(needle, before - 1);
+            size_t found = TextSearch::FindPrevious(runs, needle, before);
+            if (found != (expected == std::string::npos ? TextSearch::NotFound : expected)) {
+                fprintf(stderr, "FindPrevious(\"%s\", %zu) = %zu, expected %zu\n", needle, before, found, expected);
+                return 1;
+            }
+        }
+    }
+    printf("FindPrevious agrees with rfind\n");
+    return 0;
+}
+
+// regex [--size-mb N]: every match of a few patterns over a log document, with Regex on
+// the document and with std::regex on a flattened copy of it, plus the DFA's counters.
+int BenchRegex(int argc, char** argv) {
+    size_t sizeMiB = OptionValue(argc, argv, "--size-mb", 64);
+
+    // None of these have a match that std::regex, taking the first alternative that
+    // matches rather than the longest, would end elsewhere; the counts should agree.
+    static const char* const patterns[] = {
+        "\\d{4}-\\d{2}-\\d{2} \\d{2}:\\d{2}",  // on every line
+        "worker-6[0-3] request",               // a literal prefix; a line in 16
+        "bytes=\\d{5} ",                       // most lines, late in the line
+        "status=[45]\\d\\d",                   // a literal prefix, never matching
+        "[Ee]rror|[Ff]atal|timeout",           // no prefix, never matching
+    };
+    std::string text = MakeLogText(sizeMiB * 1024 * 1024);
+    PieceTable document;
+    document.Load(text);
+
+    printf("%zu MiB\n", sizeMiB);
+    printf("%-34s %9s %9s %9s %9s %7s %7s %5s\n", "pattern", "matches", "MB/s", "std", "std MB/s", "states", "clears", "nfa");
+    for (const char* pattern : patterns) {
+        Regex regex;
+        std::string error;
+        if (!regex.Compile(pattern, error)) {
+            fprintf(stderr, "%s: %s\n", pattern, error.c_str());
+            return 1;
+        }
+        Clock::time_point start = Clock::now();
+        size_t count = 0;
+        TextSearch::ForEachMatch(document, regex, 0, document.Size(), [&](size_t, size_t) {
+            count++;
+            return true;
+        });
+        double ms = Milliseconds(start);
+
+        std::regex standard(pattern);
+        start = Clock::now();
+        size_t standardCount = (size_t)std::distance(std::sregex_iterator(text.begin(), text.end(), standard),
+            std::sregex_iterator());
+        double standardMs = Milliseconds(start);
+
+        printf("%-34s %9zu %9.0f %9zu %9.0f %7zu %7zu %5zu\n", pattern, count, text.size() / (ms * 1e3), standardCount,
+            text.size() / (standardMs * 1e3), regex.StatesBuilt(), regex.CacheClears(), regex.NfaFallbacks());
+    }
+    return 0;
+}
+
+// incremental [--size-mb N]: a query typed a byte at a time and then erased over a log
+// document, timing each keystroke until IncrementalFind has the full count, next to a
+// rescan of the whole document for the same query.
+int BenchIncremental(int argc, char** argv) {
+    size_t sizeMiB = OptionValue(argc, argv, "--size-mb", 256);
+
+    PieceTable document;
+    document.Load(MakeLogText(sizeMiB * 1024 * 1024));
+    const std::string typed = "worker-63 request";
+    std::vector<std::string> queries;
+    for (size_t i = 1; i <= typed.size(); i++) queries.push_back(typed.substr(0, i));
+    for (size_t i = typed.size() - 1; i >= 3; i--) queries.push_back(typed.substr(0, i));
+
+    IncrementalFind find;
+    printf("%zu MiB\n", sizeMiB);
+    printf("%-20s %10s %12s %12s\n", "query", "matches", "incremental", "rescan ms");
+    for (const std::string& query : queries) {
+        Clock::time_point start = Clock::now();
+        find.Poll(document, query, false);
+        while (!find.Complete()) {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            find.Poll(document, query, false);
+        }
+        double ms = Milliseconds(start);
+
+        start = Clock::now();
+        size_t count = 0;
+        TextSearch::ForEachMatch(document, query, 0, document.Size(), [&](size_t) {
+            count++;
+            return true;
+        });
+        double rescanMs = Milliseconds(start);
+        if (count != find.Count()) {
+            fprintf(stderr, "%s: counted %zu, expected %zu\n", query.c_str(), find.Count(), count);
+            return 1;
+        }
+        printf("%-20s %10zu %12.2f %12.2f\n", ("\"" + query + "\"").c_str(), count, ms, rescanMs);
+    }
+    return 0;
+}
+
+// files [dir] [--size-mb N] [--threads N]: Find in Files over dir, or over a generated
+// tree of log files with a few binary ones, with one worker and with all of them (or N):
+// when the first result arrived and how long the whole search took.
+int BenchFiles(int argc, char** argv) {
+    std::string root = PathArgument(argc, argv);
+    size_t sizeMiB = OptionValue(argc, argv, "--size-mb", 1024);
+    unsigned threads = (unsigned)OptionValue(argc, argv, "--threads", 0);
+    bool generated = root.empty();
+    if (generated) {
+        root = "texteditor-bench-files";
+        printf("Generating %zu MiB in %s...\n", sizeMiB, root.c_str());
+        const std::string& block = LogBlock();
+        for (size_t i = 0; i < sizeMiB * 4; i++) {
+            std::filesystem::path directory = std::filesystem::path(root) / std::to_string(i % 16) / std::to_string(i % 256);
+            std::filesystem::create_directories(directory);
+            std::ofstream file(directory / (std::to_string(i) + (i % 64 == 0 ? ".bin" : ".log")), std::ios::binary);
+            if (i % 64 == 0) file.put('\0');
+            file.write(block.data() + (i * 4096) % (block.size() / 2), block.size() / 4);
+        }
+    }
+
+    static const char* const queries[] = { "worker-63 request", "status=599" };
+    printf("%-20s %8s %10s %10s %12s %10s %8s\n", "query", "threads", "matches", "first ms", "total ms", "MiB", "GB/s");
+    for (const char* query : queries) {
+        for (unsigned count : { 1u, threads }) {
+            FileSearch search;
+            FileSearch::Options options;
+            options.root = root;
+            options.query = query;
+            options.threads = count;
+            std::string error;
+            std::vector<FileSearch::FileResult> results;
+            Clock::time_point start = Clock::now();
+            if (!search.Start(options, error)) { fprintf(stderr, "%s\n", error.c_str()); return 1; }
+            double firstMs = -1;
+            while (search.Busy()) {
+                if (search.Poll(results) && firstMs < 0 && !results.empty()) firstMs = Milliseconds(start);
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+            double ms = Milliseconds(start);
+            printf("%-20s %8u %10zu %10.2f %12.1f %10.0f %8.2f\n", query,
+                count ? count : std::max(1u, std::thread::hardware_concurrency()), search.MatchCount(), firstMs, ms,
+                ToMiB(search.BytesSearched()), search.BytesSearched() / (ms * 1e6));
+        }
+    }
+
+    if (generated) std::filesystem::remove_all(root);
+    return 0;
+}
+
+}
+
+size_t OptionValue(int argc, char** argv, const char* name, size_t fallback) {
+    for (int i = 0; i + 1 < argc; i++)
+        if (!strcmp(argv[i], name)) return strtoull(argv[i + 1], nullptr, 10);
+    return fallback;
+}
+
+bool GenerateLogFile(const std::string& path, size_t sizeMiB) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+    const std::string& block = LogBlock();
+    for (size_t i = 0; i < sizeMiB && file; i++) file.write(block.data(), block.size());
+    return bool(file);
+}
+
+int RunBenchmark(int argc, char** argv) {
+    if (argc >= 1 && !strcmp(argv[0], "load")) return BenchLoad(argc - 1, argv + 1);
+    if (argc >= 1 && !strcmp(argv[0], "save")) return BenchSave(argc - 1, argv + 1);
+    if (argc >= 1 && !strcmp(argv[0], "undo")) return BenchUndo(argc - 1, argv + 1);
+    if (argc >= 1 && !strcmp(argv[0], "lines")) return BenchLines(argc - 1, argv + 1);
+    if (argc >= 1 && !strcmp(argv[0], "kernels")) return BenchKernels(argc - 1, argv + 1);
+    if (argc >= 1 && !strcmp(argv[0], "view")) return BenchView(argc - 1, argv + 1);
+    if (argc >= 1 && !strcmp(argv[0], "wrap")) return BenchWrap(argc - 1, argv + 1);
+    if (argc >= 1 && !strcmp(argv[0], "longline")) return BenchLongLine(argc - 1, argv + 1);
+    if (argc >= 1 && !strcmp(argv[0], "find")) return BenchFind(argc - 1, argv + 1);
+    if (argc >= 1 && !strcmp(argv[0], "regex")) return BenchRegex(argc - 1, argv + 1);
+    if (argc >= 1 && !strcmp(argv[0], "replace")) return BenchReplace(argc - 1, argv + 1);
+    if (argc >= 1 && !strcmp(argv[0], "incremental")) return BenchIncremental(argc - 1, argv + 1);
+    if (argc >= 1 && !strcmp(argv[0], "files")) return BenchFiles(argc - 1, argv + 1);
+    fprintf(stderr, "Usage: TextEditor --bench load [file] [--size-mb N]\n"
+                    "       TextEditor --bench save [--size-mb N]\n"
+                    "       TextEditor --bench undo [--max-mb N]\n"
+                    "       TextEditor --bench lines [--max-mb N]\n"
+                    "       TextEditor --bench kernels [--size-mb N]\n"
+                    "       TextEditor --bench view [--max-lines N]\n"
+                    "       TextEditor --bench wrap [--size-mb N]\n"
+                    "       TextEditor --bench longline [--size-mb N]\n"
+                    "       TextEditor --bench find [--size-mb N]\n"
+                    "       TextEditor --bench regex [--size-mb N]\n"
+                    "       TextEditor --bench replace [--size-mb N]\n"
+                    "       TextEditor --bench incremental [--size-mb N]\n"
+                    "       TextEditor --bench files [dir] [--size-mb N] [--threads N]\n");
+    return 1;
+}
@@ -0,0 +1,845 @@
+#include "EditorView.h"
+#include "TextSearch.h"
+#include <imgui_internal.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+
+namespace {
+
+// Cursor blink cycle in seconds, matching ImGui's text widgets.
+constexpr double BlinkPeriod = 1.20;
+constexpr double BlinkVisible = 0.80;
+
+// Keys the view handles itself while focused, taken away from keyboard navigation.
+const ImGuiKey OwnedKeys[] = {
+    ImGuiKey_LeftArrow, ImGuiKey_RightArrow, ImGuiKey_UpArrow, ImGuiKey_DownArrow,
+    ImGuiKey_PageUp, ImGuiKey_PageDown, ImGuiKey_Home, ImGuiKey_End,
+    ImGuiKey_Enter, ImGuiKey_KeypadEnter, ImGuiKey_Tab, ImGuiKey_Space,
+    ImGuiKey_Backspace, ImGuiKey_Delete,
+};
+
+// Length of the UTF-8 sequence starting with lead; stray continuation bytes count as one.
+size_t Utf8Length(unsigned char lead) {
+    if (lead < 0xC0) return 1;
+    if (lead < 0xE0) return 2;
+    if (lead < 0xF0) return 3;
+    return 4;
+}
+
+bool IsContinuation(char c) { return ((unsigned char)c & 0xC0) == 0x80; }
+
+void AppendUtf8(std::string& out, unsigned int c) {
+    if (c < 0x80) {
+        out += (char)c;
+    }
+    else if (c < 0x800) {
+        out += (char)(0xC0 | (c >> 6));
+        out += (char)(0x80 | (c & 0x3F));
+    }
+    else if (c < 0x10000) {
+        out += (char)(0xE0 | (c >> 12));
+        out += (char)(0x80 | ((c >> 6) & 0x3F));
+        out += (char)(0x80 | (c & 0x3F));
+    }
+    else {
+        out += (char)(0xF0 | (c >> 18));
+        out += (char)(0x80 | ((c >> 12) & 0x3F));
+        out += (char)(0x80 | ((c >> 6) & 0x3F));
+        out += (char)(0x80 | (c & 0x3F));
+    }
+}
+
+// Character classes for word-wise movement: spaces, word characters, punctuation.
+int CharClass(char c) {
+    unsigned char u = (unsigned char)c;
+    if (isspace(u)) return 0;
+    if (isalnum(u) || u == '_' || u >= 0x80) return 1;
+    return 2;
+}
+
+size_t PrevCharStart(const PieceTable& document, size_t pos) {
+    if (pos == 0) return 0;
+    size_t start = pos - 1;
+    while (start > 0 && pos - start < 4 && IsContinuation(document.At(start))) start--;
+    return start;
+}
+
+size_t NextCharEnd(const PieceTable& document, size_t pos) {
+    if (pos >= document.Size()) return document.Size();
+    return std::min(pos + Utf8Length((unsigned char)document.At(pos)), document.Size());
+}
+
+// Word-wise movement and selection go no further than a segment of a long line at a
+// time, so a line that is one huge word costs no more than a short one.
+constexpr size_t MaxWordBytes = LineSegments::SegmentBytes;
+
+// Start of the run of characters of class type that ends at pos, stopping at limit.
+size_t RunStart(const PieceTable& document, size_t pos, size_t limit, int type) {
+    // Spans only come in document order; they are collected to be walked backward.
+    std::vector<std::pair<const char*, size_t>> spans;
+    document.ForEachSpan(limit, pos - limit, [&](const char* data, size_t size) {
+        spans.emplace_back(data, size);
+        return true;
+    });
+    for (size_t i = spans.size(); i-- > 0;)
+        for (size_t j = spans[i].second; j-- > 0; pos--)
+            if (CharClass(spans[i].first[j]) != type) return pos;
+    return pos;
+}
+
+// End of the run of characters of class type that starts at pos, stopping at limit.
+size_t RunEnd(const PieceTable& document, size_t pos, size_t limit, int type) {
+    document.ForEachSpan(pos, limit - pos, [&](const char* data, size_t size) {
+        for (size_t i = 0; i < size; i++, pos++)
+            if (CharClass(data[i]) != type) return false;
+        return true;
+    });
+    return pos;
+}
+
+// A run cut short at a limit inside the document may end inside a character; moves on
+// to the next one.
+size_t CharBoundary(const PieceTable& document, size_t pos, size_t limit) {
+    if (pos != limit || limit == 0) return pos;
+    for (size_t i = 0; i < 3 && IsContinuation(document.At(pos)); i++) pos++;
+    return pos;
+}
+
+// Skips spaces, then a run of one character class.
+size_t PrevWordStart(const PieceTable& document, size_t pos) {
+    size_t limit = pos - std::min(pos, MaxWordBytes);
+    pos = RunStart(document, pos, limit, 0);
+    if (pos > limit) pos = RunStart(document, pos, limit, CharClass(document.At(pos - 1)));
+    return CharBoundary(document, pos, limit);
+}
+
+size_t NextWordEnd(const PieceTable& document, size_t pos) {
+    size_t limit = std::min(pos + MaxWordBytes, document.Size());
+    pos = RunEnd(document, pos, limit, 0);
+    if (pos < limit) pos = RunEnd(document, pos, limit, CharClass(document.At(pos)));
+    return CharBoundary(document, pos, limit);
+}
+
+}
+
+void EditorView::ReadLine(const PieceTable& document, size_t line, Line& out) {
+    out.start = document.LineStart(line);
+    out.length = document.LineEnd(line) - out.start;
+    out.segments = nullptr;
+    if (out.length > MaxLayoutBytes) {
+        static const std::shared_ptr<const LineLayout> empty = std::make_shared<LineLayout>();
+        LineSegments& segments = longLines[line];
+        out.segments = &segments;
+        out.text.clear();
+        out.layout = empty;
+        out.rows.assign(1, 0);
+        if (segments.Start() != out.start || segments.Length() != out.length) {
+            // The other segments are guessed from the first until they come into view.
+            size_t begin;
+            segments.Reset(out.start, out.length, 0.0);
+            std::shared_ptr<const LineLayout> first = SegmentLayout(document, out, 0, begin);
+            double estimate = first->bytes ? first->width / first->bytes * LineSegments::SegmentBytes : 0.0;
+            segments.Reset(out.start, out.length, estimate);
+            segments.SetWidth(0, first->width);
+        }
+        if (wrap && segments.RowWidth() != wrapWidth) {
+            // And so are their rows.
+            Line first;
+            segments.ResetRows(wrapWidth, 1);
+            SegmentLine(document, out, 0, first);
+            segments.ResetRows(wrapWidth, first.rows.size());
+        }
+        if (wrap && line < wraps.LineCount()) wraps.SetRows(line, (size_t)segments.TotalRows());
+        return;
+    }
+    out.text = document.Read(out.start, out.length);
+    out.layout = layouts.Get(out.text, ImGui::GetFont(), ImGui::GetFontSize());
+    if (wrap) {
+        out.rows = out.layout->Wrap(out.text, wrapWidth);
+        if (line < wraps.LineCount()) wraps.SetRows(line, out.rows.size());
+    }
+    else {
+        out.rows.assign(1, 0);
+    }
+}
+
+size_t EditorView::OffsetAt(const PieceTable& document, const ImVec2& origin, const ImVec2& mouse) {
+    const ImGuiStyle& style = ImGui::GetStyle();
+    double offset = std::floor((mouse.y - origin.y - style.FramePadding.y) / lineHeight);
+    size_t line = topLine, row = topRow;
+    StepRows(document, line, row, (long long)offset);
+    Line text;
+    ReadLine(document, line, text);
+    row = std::min(row, RowCount(text) - 1);
+    return text.start + ColumnInRow(document, text, row, mouse.x - origin.x - style.FramePadding.x + scrollX);
+}
+
+size_t EditorView::SegmentStart(const PieceTable& document, const Line& line, size_t segment) const {
+    size_t lineEnd = line.start + line.length;
+    size_t start = std::min(line.start + segment * LineSegments::SegmentBytes, lineEnd);
+    if (segment == 0) return start;
+    for (size_t i = 0; i < 3 && start < lineEnd && IsContinuation(document.At(start)); i++) start++;
+    return start;
+}
+
+size_t EditorView::SegmentOf(const PieceTable& document, const Line& line, size_t column) const {
+    size_t segment = std::min(column / LineSegments::SegmentBytes, line.segments->Count() - 1);
+    if (segment > 0 && line.start + column < SegmentStart(document, line, segment)) segment--;
+    return segment;
+}
+
+std::shared_ptr<const LineLayout> EditorView::SegmentLayout(const PieceTable& document, const Line& line, size_t segment,
+    size_t& begin) {
+    begin = SegmentStart(document, line, segment);
+    size_t end = segment + 1 < line.segments->Count() ? SegmentStart(document, line, segment + 1) : line.start + line.length;
+    std::shared_ptr<const LineLayout> layout = layouts.Get(document.Read(begin, end - begin), ImGui::GetFont(), ImGui::GetFontSize());
+    line.segments->SetWidth(segment, layout->width);
+    return layout;
+}
+
+void EditorView::SegmentLine(const PieceTable& document, const Line& line, size_t segment, Line& out) {
+    out.layout = SegmentLayout(document, line, segment, out.start);
+    out.length = out.layout->bytes;
+    out.text = document.Read(out.start, out.length);
+    out.rows = out.layout->Wrap(out.text, wrapWidth);
+    out.segments = nullptr;
+    line.segments->SetRows(segment, out.rows.size());
+}
+
+double EditorView::ColumnX(const PieceTable& document, const Line& line, size_t column) {
+    if (!line.segments) return line.layout->XAt(column);
+    size_t segment = SegmentOf(document, line, column);
+    size_t begin;
+    std::shared_ptr<const LineLayout> layout = SegmentLayout(document, line, segment, begin);
+    return line.segments->XOf(segment) + layout->XAt(line.start + column - begin);
+}
+
+size_t EditorView::XColumn(const PieceTable& document, const Line& line, double x) {
+    if (!line.segments) return line.layout->ColumnAt((float)x);
+    const LineSegments& segments = *line.segments;
+    size_t segment = segments.SegmentAt(x);
+    size_t begin;
+    std::shared_ptr<const LineLayout> layout = SegmentLayout(document, line, segment, begin);
+    // Measuring the segment may have shown it ends before x.
+    while (x >= segments.XOf(segment) + layout->width && segment + 1 < segments.Count())
+        layout = SegmentLayout(document, line, ++segment, begin);
+    return begin - line.start + layout->ColumnAt((float)(x - segments.XOf(segment)));
+}
+
+size_t EditorView::RowCount(const Line& line) const {
+    return wrap && line.segments ? (size_t)line.segments->TotalRows() : line.rows.size();
+}
+
+size_t EditorView::RowOfColumn(const Line& line, size_t column) {
+    const std::vector<LineLayout::Glyph>& glyphs = line.layout->glyphs;
+    size_t glyph = std::lower_bound(glyphs.begin(), glyphs.end(), column,
+        [](const LineLayout::Glyph& g, size_t value) { return g.offset < value; }) - glyphs.begin();
+    return std::upper_bound(line.rows.begin(), line.rows.end(), (uint32_t)glyph) - line.rows.begin() - 1;
+}
+
+size_t EditorView::RowOfColumn(const PieceTable& document, const Line& line, size_t column) {
+    if (!wrap || !line.segments) return RowOfColumn(line, column);
+    size_t segment = SegmentOf(document, line, column);
+    Line text;
+    SegmentLine(document, line, segment, text);
+    return (size_t)line.segments->RowOf(segment) + RowOfColumn(text, line.start + column - text.start);
+}
+
+const EditorView::Line& EditorView::RowLine(const PieceTable& document, const Line& line, size_t& row, Line& segment) {
+    if (!wrap || !line.segments) return line;
+    size_t target = row;
+    for (;;) {
+        size_t index = line.segments->SegmentAtRow(target, row);
+        // Rows drawn one after another mostly fall in the segment laid out last.
+        if (segment.layout && segment.start == SegmentStart(document, line, index)) break;
+        // Laying a segment out replaces its estimated row count, which can move the row
+        // into a neighbour; a measured segment keeps its count, so this settles.
+        SegmentLine(document, line, index, segment);
+    }
+    return segment;
+}
+
+float EditorView::RowLeft(const Line& line, size_t row) {
+    const std::vector<LineLayout::Glyph>& glyphs = line.layout->glyphs;
+    return line.rows[row] < glyphs.size() ? glyphs[line.rows[row]].x : line.layout->width;
+}
+
+size_t EditorView::ColumnInRow(const PieceTable& document, const Line& line, size_t row, double x) {
+    if (line.segments && !wrap) return XColumn(document, line, x);
+    if (line.segments) {
+        Line segment;
+        const Line& text = RowLine(document, line, row, segment);
+        size_t column = text.start - line.start + ColumnInRow(document, text, row, x);
+        // The end of a segment that doesn't end the line is the start of the next row.
+        if (row + 1 == text.rows.size() && text.start + text.length < line.start + line.length && !text.layout->glyphs.empty())
+            column = std::min<size_t>(column, text.start - line.start + text.layout->glyphs.back().offset);
+        return column;
+    }
+    const std::vector<LineLayout::Glyph>& glyphs = line.layout->glyphs;
+    size_t column = line.layout->ColumnAt((float)x + RowLeft(line, row));
+    size_t first = line.rows[row] < glyphs.size() ? glyphs[line.rows[row]].offset : line.layout->bytes;
+    // Past the end of a wrapped row is before its last character (usually the space it
+    // broke at), so the position stays on that row.
+    if (row + 1 < line.rows.size()) column = std::min<size_t>(column, glyphs[line.rows[row + 1] - 1].offset);
+    return std::max(column, first);
+}
+
+void EditorView::StepRows(const PieceTable& document, size_t& line, size_t& row, long long delta) {
+    Line text;
+    ReadLine(document, line, text);
+    row = std::min(row, RowCount(text) - 1);
+    while (delta > 0) {
+        if (row + delta < RowCount(text)) {
+            row += (size_t)delta;
+            return;
+        }
+        if (line + 1 >= document.LineCount()) {
+            row = RowCount(text) - 1;
+            return;
+        }
+        delta -= (long long)(RowCount(text) - row);
+        ReadLine(document, ++line, text);
+        row = 0;
+    }
+    while (delta < 0) {
+        if ((size_t)-delta <= row) {
+            row -= (size_t)-delta;
+            return;
+        }
+        if (line == 0) {
+            row = 0;
+            return;
+        }
+        delta += (long long)row + 1;
+        ReadLine(document, --line, text);
+        row = RowCount(text) - 1;
+    }
+}
+
+uint64_t EditorView::TotalRows(const PieceTable& document) const {
+    return wrap ? wraps.TotalRows() : document.LineCount();
+}
+
+uint64_t EditorView::TopRow() const {
+    return wrap && topLine < wraps.LineCount() ? wraps.RowOf(topLine) + topRow : topLine;
+}
+
+void EditorView::SetTopRow(const PieceTable& document, uint64_t row) {
+    uint64_t last = TotalRows(document) - 1;
+    row = std::min(row, last);
+    if (wrap) topLine = wraps.LineAtRow(row, topRow);
+    else topLine = (size_t)row;
+}
+
+void EditorView::SetWrap(bool enabled) {
+    wrap = enabled;
+    // Emptied so the next frame measures from scratch at the current width.
+    wraps.Reset(0, 0.0f);
+    topRow = 0;
+    scrollX = 0.0;
+    preferredX = -1.0;
+}
+
+void EditorView::TextChanged(size_t line, size_t removedLines, size_t insertedLines) {
+    if (wrap && line < wraps.LineCount()) wraps.Replace(line, removedLines + 1, insertedLines + 1);
+    // Line numbers past the edit moved; the start/length check in ReadLine would catch
+    // most of it, but not a line that moved onto another of the same length.
+    if (removedLines != insertedLines) {
+        for (auto it = longLines.begin(); it != longLines.end();)
+            it = it->first >= line ? longLines.erase(it) : std::next(it);
+    }
+    else {
+        for (size_t i = 0; i <= removedLines; i++) longLines.erase(line + i);
+    }
+}
+
+void EditorView::SyncWraps(const PieceTable& document) {
+    if (!wrap) return;
+    size_t lines = wraps.LineCount();
+    if (lines > 0 && lines < document.LineCount() && wraps.Width() == wrapWidth) {
+        // Lines appended by the loader; its last line may have grown as well.
+        wraps.Replace(lines - 1, 1, document.LineCount() - lines + 1);
+        return;
+    }
+    // Any other line count that doesn't match means an edit wasn't reported; start over.
+    if (lines != document.LineCount()) wraps.Reset(document.LineCount(), wrapWidth);
+    else if (wraps.Width() != wrapWidth) wraps.Rescale(wrapWidth);
+    else return;
+    // Measure outward from what's on screen first.
+    refineNext = topLine;
+}
+
+void EditorView::RefineWraps(const PieceTable& document) {
+    if (!Reflowing()) return;
+    ImFont* font = ImGui::GetFont();
+    float fontSize = ImGui::GetFontSize();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    size_t line = wraps.NextUnmeasured(refineNext);
+    std::string text;
+    for (size_t count = 1; line < wraps.LineCount(); count++) {
+        size_t begin = document.LineStart(line);
+        size_t length = document.LineEnd(line) - begin;
+        text = document.Read(begin, std::min(length, MaxLayoutBytes));
+        // Built outside the cache: these lines aren't about to be drawn.
+        size_t rows = LayoutCache::Build(text, font, fontSize)->Wrap(text, wrapWidth).size();
+        // A long line is laid out a segment at a time once it's on screen; until then its
+        // rows are taken to go on as they start.
+        if (length > text.size()) rows = (size_t)((double)rows * length / text.size());
+        wraps.SetRows(line, rows);
+        line = wraps.NextUnmeasured(line + 1);
+        if (count % 16 == 0 &&
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > RefineSeconds)
+            break;
+    }
+    refineNext = line;
+}
+
+void EditorView::MoveTo(size_t offset, bool select) {
+    cursor = offset;
+    if (!select) anchor = offset;
+    preferredX = -1.0;
+    scrollToCursor = true;
+    blinkStart = ImGui::GetTime();
+}
+
+void EditorView::MoveVertical(const PieceTable& document, long long rows, bool select) {
+    size_t line, column;
+    document.LineColumn(cursor, line, column);
+    Line current;
+    ReadLine(document, line, current);
+    size_t row = RowOfColumn(document, current, column);
+    size_t targetLine = line, targetRow = row;
+    StepRows(document, targetLine, targetRow, rows);
+    if (targetLine == line && targetRow == row) {
+        // Already on the first or last row.
+        MoveTo(rows < 0 ? 0 : document.Size(), select);
+        return;
+    }
+    double x = preferredX;
+    if (x < 0.0) {
+        Line segment;
+        size_t textRow = row;
+        const Line& text = RowLine(document, current, textRow, segment);
+        x = ColumnX(document, text, current.start + column - text.start) - RowLeft(text, textRow);
+    }
+    Line next;
+    ReadLine(document, targetLine, next);
+    MoveTo(next.start + ColumnInRow(document, next, targetRow, x), select);
+    preferredX = x;
+}
+
+bool EditorView::Replace(size_t start, size_t removed, const std::string& text, bool typing, const EditHandler& edit) {
+    if (!edit(start, removed, text, typing)) return false;
+    MoveTo(start + text.size(), false);
+    return true;
+}
+
+void EditorView::ScrollBy(const PieceTable& document, long long rows) {
+    uint64_t top = TopRow();
+    if (rows < 0) SetTopRow(document, top - std::min(top, (uint64_t)-rows));
+    else SetTopRow(document, top + (uint64_t)rows);
+}
+
+void EditorView::EnsureCursorVisible(const PieceTable& document, float width) {
+    scrollToCursor = false;
+    size_t line, column;
+    document.LineColumn(cursor, line, column);
+    Line text;
+    ReadLine(document, line, text);
+    size_t row = RowOfColumn(document, text, column);
+    // Compared by walking rows rather than through the wrap index, whose counts off
+    // screen may still be estimates.
+    if (line < topLine || (line == topLine && row < topRow)) {
+        topLine = line;
+        topRow = row;
+    }
+    else if (line - topLine <= visibleLines) {
+        size_t bottomLine = topLine, bottomRow = topRow;
+        StepRows(document, bottomLine, bottomRow, (long long)visibleLines - 1);
+        if (line > bottomLine || (line == bottomLine && row > bottomRow)) {
+            topLine = line;
+            topRow = row;
+            StepRows(document, topLine, topRow, 1 - (long long)visibleLines);
+        }
+    }
+    else {
+        topLine = line;
+        topRow = row;
+        StepRows(document, topLine, topRow, 1 - (long long)visibleLines);
+    }
+
+    if (wrap) {
+        scrollX = 0.0;
+        return;
+    }
+    double x = ColumnX(document, text, column);
+    double margin = ImGui::GetFontSize() * 2.0;
+    if (x < scrollX) scrollX = std::max(0.0, x - margin);
+    else if (x > scrollX + width - margin) scrollX = x - width + margin;
+}
+
+void EditorView::HandleMouse(const PieceTable& document, const ImVec2& origin, const ImVec2& size) {
+    ImGuiIO& io = ImGui::GetIO();
+    bool hovered = ImGui::IsItemHovered();
+    if (hovered) {
+        ImGui::SetMouseCursor(ImGuiMouseCursor_TextInput);
+        if (io.MouseWheel != 0.0f) ScrollBy(document, (long long)std::lround(-io.MouseWheel * 3.0f));
+        if (io.MouseWheelH != 0.0f && !wrap) scrollX = std::max(0.0, scrollX - io.MouseWheelH * ImGui::GetFontSize() * 3.0);
+    }
+
+    if (ImGui::IsItemActivated() && ImGui::IsMouseDown(ImGuiMouseButton_Left)) {
+        size_t offset = OffsetAt(document, origin, io.MousePos);
+        MoveTo(offset, io.KeyShift);
+        if (ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)) {
+            // Select the run of same-class characters under the mouse.
+            int type = CharClass(document.At(offset));
+            size_t first = offset - std::min(offset, MaxWordBytes);
+            size_t last = std::min(offset + MaxWordBytes, document.Size());
+            anchor = CharBoundary(document, RunStart(document, offset, first, type), first);
+            cursor = CharBoundary(document, RunEnd(document, offset, last, type), last);
+        }
+    }
+    else if (ImGui::IsItemActive() && ImGui::IsMouseDragging(ImGuiMouseButton_Left)) {
+        // Dragging past the top or bottom edge scrolls a row per frame.
+        if (io.MousePos.y < origin.y) ScrollBy(document, -1);
+        else if (io.MousePos.y > origin.y + size.y) ScrollBy(document, 1);
+        cursor = OffsetAt(document, origin, io.MousePos);
+        preferredX = -1.0;
+        blinkStart = ImGui::GetTime();
+    }
+}
+
+void EditorView::HandleKeyboard(const PieceTable& document, bool readOnly, const EditHandler& edit) {
+    ImGuiIO& io = ImGui::GetIO();
+    bool shift = io.KeyShift;
+    bool ctrl = io.KeyCtrl;
+    auto replaceSelection = [&](const std::string& text, bool typing) {
+        if (!readOnly) Replace(SelectionStart(), SelectionEnd() - SelectionStart(), text, typing && !HasSelection(), edit);
+    };
+
+    if (!ctrl && !io.InputQueueCharacters.empty()) {
+        std::string text;
+        for (ImWchar c : io.InputQueueCharacters)
+            if (c >= 32 && c != 127) AppendUtf8(text, c);
+        if (!text.empty()) replaceSelection(text, true);
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_Enter) || ImGui::IsKeyPressed(ImGuiKey_KeypadEnter)) replaceSelection("\n", true);
+    if (ImGui::IsKeyPressed(ImGuiKey_Tab) && !ctrl) replaceSelection("\t", true);
+
+    if (ImGui::IsKeyPressed(ImGuiKey_Backspace) && !readOnly) {
+        if (HasSelection()) replaceSelection("", false);
+        else if (cursor > 0) {
+            size_t start = ctrl ? PrevWordStart(document, cursor) : PrevCharStart(document, cursor);
+            Replace(start, cursor - start, "", !ctrl, edit);
+        }
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_Delete) && !readOnly) {
+        if (HasSelection()) replaceSelection("", false);
+        else if (cursor < document.Size()) {
+            size_t end = ctrl ? NextWordEnd(document, cursor) : NextCharEnd(document, cursor);
+            Replace(cursor, end - cursor, "", !ctrl, edit);
+        }
+    }
+
+    if (ImGui::IsKeyPressed(ImGuiKey_LeftArrow)) {
+        if (HasSelection() && !shift) MoveTo(SelectionStart(), false);
+        else MoveTo(ctrl ? PrevWordStart(document, cursor) : PrevCharStart(document, cursor), shift);
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_RightArrow)) {
+        if (HasSelection() && !shift) MoveTo(SelectionEnd(), false);
+        else MoveTo(ctrl ? NextWordEnd(document, cursor) : NextCharEnd(document, cursor), shift);
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_UpArrow)) MoveVertical(document, -1, shift);
+    if (ImGui::IsKeyPressed(ImGuiKey_DownArrow)) MoveVertical(document, 1, shift);
+    if (ImGui::IsKeyPressed(ImGuiKey_PageUp)) {
+        ScrollBy(document, -(long long)visibleLines);
+        MoveVertical(document, -(long long)visibleLines, shift);
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_PageDown)) {
+        ScrollBy(document, (long long)visibleLines);
+        MoveVertical(document, (long long)visibleLines, shift);
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_Home) || ImGui::IsKeyPressed(ImGuiKey_End)) {
+        bool home = ImGui::IsKeyPressed(ImGuiKey_Home);
+        size_t line, column;
+        document.LineColumn(cursor, line, column);
+        if (ctrl) MoveTo(home ? 0 : document.Size(), shift);
+        else MoveTo(home ? document.LineStart(line) : document.LineEnd(line), shift);
+    }
+
+    if (ctrl && ImGui::IsKeyPressed(ImGuiKey_A, false)) {
+        anchor = 0;
+        cursor = document.Size();
+    }
+    if (ctrl && (ImGui::IsKeyPressed(ImGuiKey_C, false) || ImGui::IsKeyPressed(ImGuiKey_X, false)) && HasSelection()) {
+        std::string text = document.Read(SelectionStart(), SelectionEnd() - SelectionStart());
+        ImGui::SetClipboardText(text.c_str());
+        if (ImGui::IsKeyPressed(ImGuiKey_X, false)) replaceSelection("", false);
+    }
+    if (ctrl && ImGui::IsKeyPressed(ImGuiKey_V)) {
+        const char* clip = ImGui::GetClipboardText();
+        if (clip && *clip) replaceSelection(clip, false);
+    }
+}
+
+void EditorView::RenderScrollbar(const PieceTable& document, const ImVec2& origin, const ImVec2& size) {
+    const ImGuiStyle& style = ImGui::GetStyle();
+    ImGuiIO& io = ImGui::GetIO();
+    ImGui::InvisibleButton("##scrollbar", size);
+
+    // The thumb covers the visible share of the rows, but never less than a grab's worth.
+    uint64_t lastTop = TotalRows(document) - 1;
+    uint64_t top = TopRow();
+    float thumb = (float)(size.y * (double)visibleLines / (double)(lastTop + visibleLines));
+    thumb = std::min(std::max(thumb, style.GrabMinSize), size.y);
+    float travel = size.y - thumb;
+    if (ImGui::IsItemActivated()) {
+        float thumbTop = origin.y + (lastTop ? (float)(travel * ((double)top / lastTop)) : 0.0f);
+        bool onThumb = io.MousePos.y >= thumbTop && io.MousePos.y < thumbTop + thumb;
+        // Clicking the track centers the thumb on the mouse.
+        grabOffset = onThumb ? io.MousePos.y - thumbTop : thumb * 0.5f;
+    }
+    if (ImGui::IsItemActive() && travel > 0.0f) {
+        double t = std::min(std::max((io.MousePos.y - grabOffset - origin.y) / (double)travel, 0.0), 1.0);
+        top = (uint64_t)std::llround(t * lastTop);
+        SetTopRow(document, top);
+    }
+
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    ImVec2 max(origin.x + size.x, origin.y + size.y);
+    drawList->AddRectFilled(origin, max, ImGui::GetColorU32(ImGuiCol_ScrollbarBg), style.ScrollbarRounding);
+    float thumbTop = origin.y + (lastTop ? (float)(travel * ((double)std::min(top, lastTop) / lastTop)) : 0.0f);
+    ImGuiCol color = ImGui::IsItemActive() ? ImGuiCol_ScrollbarGrabActive
+        : ImGui::IsItemHovered() ? ImGuiCol_ScrollbarGrabHovered : ImGuiCol_ScrollbarGrab;
+    drawList->AddRectFilled(ImVec2(origin.x + 2.0f, thumbTop), ImVec2(max.x - 2.0f, thumbTop + thumb),
+        ImGui::GetColorU32(color), style.ScrollbarRounding);
+}
+
+// Horizontal counterpart of RenderScrollbar, over the widest line drawn last frame.
+void EditorView::RenderHorizontalScrollbar(const ImVec2& origin, const ImVec2& size, float viewWidth) {
+    const ImGuiStyle& style = ImGui::GetStyle();
+    ImGuiIO& io = ImGui::GetIO();
+    ImGui::SetCursorScreenPos(origin);
+    ImGui::InvisibleButton("##hscroll", size);
+
+    double content = std::max({ contentWidth, scrollX + viewWidth, (double)viewWidth });
+    double lastLeft = content - viewWidth;
+    float thumb = (float)(size.x * viewWidth / content);
+    thumb = std::min(std::max(thumb, style.GrabMinSize), size.x);
+    float travel = size.x - thumb;
+    if (ImGui::IsItemActivated()) {
+        float thumbLeft = origin.x + (lastLeft > 0.0 ? (float)(travel * (scrollX / lastLeft)) : 0.0f);
+        bool onThumb = io.MousePos.x >= thumbLeft && io.MousePos.x < thumbLeft + thumb;
+        grabOffset = onThumb ? io.MousePos.x - thumbLeft : thumb * 0.5f;
+    }
+    if (ImGui::IsItemActive() && travel > 0.0f) {
+        double t = std::min(std::max((io.MousePos.x - grabOffset - origin.x) / (double)travel, 0.0), 1.0);
+        scrollX = t * lastLeft;
+    }
+
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    ImVec2 max(origin.x + size.x, origin.y + size.y);
+    drawList->AddRectFilled(origin, max, ImGui::GetColorU32(ImGuiCol_ScrollbarBg), style.ScrollbarRounding);
+    float thumbLeft = origin.x + (lastLeft > 0.0 ? (float)(travel * std::min(scrollX / lastLeft, 1.0)) : 0.0f);
+    ImGuiCol color = ImGui::IsItemActive() ? ImGuiCol_ScrollbarGrabActive
+        : ImGui::IsItemHovered() ? ImGuiCol_ScrollbarGrabHovered : ImGuiCol_ScrollbarGrab;
+    drawList->AddRectFilled(ImVec2(thumbLeft, origin.y + 2.0f), ImVec2(thumbLeft + thumb, max.y - 2.0f),
+        ImGui::GetColorU32(color), style.ScrollbarRounding);
+}
+
+double EditorView::BlinkTimeout() const {
+    if (!focused || !ImGui::GetIO().ConfigInputTextCursorBlink) return -1.0;
+    double phase = std::fmod(ImGui::GetTime() - blinkStart, BlinkPeriod);
+    return phase <= BlinkVisible ? BlinkVisible - phase : BlinkPeriod - phase;
+}
+
+void EditorView::Draw(const PieceTable& document, const ImVec2& origin, const ImVec2& size) {
+    const ImGuiStyle& style = ImGui::GetStyle();
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    float fontSize = ImGui::GetFontSize();
+    ImVec2 max(origin.x + size.x, origin.y + size.y);
+    drawList->AddRectFilled(origin, max, ImGui::GetColorU32(ImGuiCol_FrameBg), style.FrameRounding);
+    drawList->PushClipRect(origin, max, true);
+
+    ImU32 textColor = ImGui::GetColorU32(ImGuiCol_Text);
+    ImU32 selectionColor = ImGui::GetColorU32(ImGuiCol_TextSelectedBg);
+    ImU32 highlightColor = ImGui::GetColorU32(ImGuiCol_PlotHistogram, 0.35f);
+    size_t selectionStart = SelectionStart();
+    size_t selectionEnd = SelectionEnd();
+    size_t cursorLine, cursorColumn;
+    document.LineColumn(cursor, cursorLine, cursorColumn);
+    bool blinkOn = !ImGui::GetIO().ConfigInputTextCursorBlink || std::fmod(ImGui::GetTime() - blinkStart, BlinkPeriod) <= BlinkVisible;
+
+    contentWidth = 0.0;
+    Line line;
+    Line segment;
+    size_t index = topLine;
+    size_t row = topRow;
+    // One row more than fits, for the partly visible one at the bottom.
+    for (size_t i = 0; i <= visibleLines && index < document.LineCount(); index++, row = 0) {
+        ReadLine(document, index, line);
+        if (index == topLine) row = topRow = std::min(topRow, RowCount(line) - 1);
+        size_t lineEnd = line.start + line.length;
+        size_t cursorRow = index == cursorLine ? RowOfColumn(document, line, cursorColumn) : SIZE_MAX;
+        size_t matched = SIZE_MAX;     // start of the text matches were last looked for in
+        for (; row < RowCount(line) && i <= visibleLines; row++, i++) {
+            float y = origin.y + style.FramePadding.y + i * lineHeight;
+            if (line.segments && !wrap) {
+                DrawSegments(document, line, y, origin.x + style.FramePadding.x, origin.x, max.x,
+                    focused && blinkOn && index == cursorLine);
+                contentWidth = std::max(contentWidth, line.segments->Width());
+                continue;
+            }
+            // The line itself, or the segment of a long one that holds the row.
+            size_t textRow = row;
+            const Line& text = RowLine(document, line, textRow, segment);
+            if (text.start != matched) {
+                matched = text.start;
+                matches.clear();
+                ForEachHighlight(document, text.start, text.start + text.length, [&](size_t start, size_t end) {
+                    matches.emplace_back(start, end);
+                    return true;
+                });
+            }
+            contentWidth = std::max(contentWidth, (double)text.layout->width);
+            float left = (float)(origin.x + style.FramePadding.x - scrollX) - RowLeft(text, textRow);
+            bool lastRow = textRow + 1 == text.rows.size();
+            size_t rowStart = text.start + (size_t)(textRow == 0 ? 0 : text.layout->glyphs[text.rows[textRow]].offset);
+            size_t rowEnd = lastRow ? text.start + text.length : text.start + text.layout->glyphs[text.rows[textRow + 1]].offset;
+
+            for (const std::pair<size_t, size_t>& match : matches) {
+                if (match.second <= rowStart || match.first >= rowEnd) continue;
+                float x1 = left + text.layout->XAt(std::max(match.first, rowStart) - text.start);
+                float x2 = left + text.layout->XAt(std::min(match.second, rowEnd) - text.start);
+                drawList->AddRectFilled(ImVec2(x1, y), ImVec2(x2, y + lineHeight), highlightColor);
+            }
+            if (selectionStart < selectionEnd && selectionEnd > rowStart &&
+                (lastRow ? selectionStart <= rowEnd : selectionStart < rowEnd)) {
+                float x1 = left + text.layout->XAt(std::max(selectionStart, rowStart) - text.start);
+                float x2 = left + text.layout->XAt(std::min(selectionEnd, rowEnd) - text.start);
+                // A selected line break shows as a sliver past the end of the line.
+                if (rowEnd == lineEnd && selectionEnd > lineEnd) x2 += fontSize * 0.4f;
+                drawList->AddRectFilled(ImVec2(x1, y), ImVec2(x2, y + lineHeight), selectionColor);
+            }
+
+            text.layout->Draw(drawList, ImVec2(left, y), origin.x, max.x, textColor,
+                text.rows[textRow], lastRow ? SIZE_MAX : text.rows[textRow + 1]);
+
+            if (focused && blinkOn && row == cursorRow) {
+                float x = left + text.layout->XAt(cursor - text.start);
+                drawList->AddLine(ImVec2(x, y), ImVec2(x, y + lineHeight - 1.0f), textColor);
+            }
+        }
+    }
+    drawList->PopClipRect();
+}
+
+void EditorView::ForEachHighlight(const PieceTable& document, size_t from, size_t to,
+    const std::function<bool(size_t start, size_t end)>& fn) {
+    if (highlightRegex) {
+        // Empty matches have nothing to show.
+        TextSearch::ForEachMatch(document, *highlightRegex, from, to - from, [&](size_t match, size_t length) {
+            return length == 0 || fn(match, match + length);
+        });
+    }
+    else if (!highlight.empty()) {
+        TextSearch::ForEachMatch(document, highlight, from, to - from, [&](size_t match) {
+            return fn(match, match + highlight.size());
+        });
+    }
+}
+
+// Draws the segments of a long line that overlap [clipLeft, clipRight], positioned in
+// double precision so the far end of the line lands on the same pixels as the start.
+void EditorView::DrawSegments(const PieceTable& document, const Line& line, float y, float textLeft, float clipLeft,
+    float clipRight, bool drawCursor) {
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    ImU32 textColor = ImGui::GetColorU32(ImGuiCol_Text);
+    ImU32 selectionColor = ImGui::GetColorU32(ImGuiCol_TextSelectedBg);
+    ImU32 highlightColor = ImGui::GetColorU32(ImGuiCol_PlotHistogram, 0.35f);
+    size_t selectionStart = SelectionStart();
+    size_t selectionEnd = SelectionEnd();
+    size_t lineEnd = line.start + line.length;
+    const LineSegments& segments = *line.segments;
+    double right = scrollX + (clipRight - textLeft);
+
+    for (size_t segment = segments.SegmentAt(std::max(0.0, scrollX - (textLeft - clipLeft)));
+        segment < segments.Count() && segments.XOf(segment) <= right; segment++) {
+        size_t begin;
+        std::shared_ptr<const LineLayout> layout = SegmentLayout(document, line, segment, begin);
+        size_t end = begin + layout->bytes;
+        bool last = segment + 1 == segments.Count();
+        float left = textLeft + (float)(segments.XOf(segment) - scrollX);
+
+        // Matches starting in this segment, looked for up to a segment further; one running
+        // into the next ends at its x there.
+        size_t limit = std::min(end + LineSegments::SegmentBytes, lineEnd);
+        ForEachHighlight(document, begin, limit, [&](size_t match, size_t matchEnd) {
+            if (match >= end) return false;
+            float x1 = left + layout->XAt(match - begin);
+            float x2 = matchEnd <= end ? left + layout->XAt(matchEnd - begin)
+                : textLeft + (float)(ColumnX(document, line, matchEnd - line.start) - scrollX);
+            drawList->AddRectFilled(ImVec2(x1, y), ImVec2(x2, y + lineHeight), highlightColor);
+            return true;
+        });
+        if (selectionStart < selectionEnd && selectionEnd > begin && selectionStart <= end) {
+            float x1 = left + layout->XAt(std::max(selectionStart, begin) - begin);
+            float x2 = left + layout->XAt(std::min(selectionEnd, end) - begin);
+            if (last && selectionEnd > lineEnd) x2 += ImGui::GetFontSize() * 0.4f;
+            drawList->AddRectFilled(ImVec2(x1, y), ImVec2(x2, y + lineHeight), selectionColor);
+        }
+
+        layout->Draw(drawList, ImVec2(left, y), clipLeft, clipRight, textColor);
+
+        if (drawCursor && cursor >= begin && (cursor < end || last)) {
+            float x = left + layout->XAt(cursor - begin);
+            drawList->AddLine(ImVec2(x, y), ImVec2(x, y + lineHeight - 1.0f), textColor);
+        }
+    }
+}
+
+void EditorView::Render(const char* id, const PieceTable& document, const ImVec2& size, bool readOnly, const EditHandler& edit) {
+    const ImGuiStyle& style = ImGui::GetStyle();
+    cursor = std::min(cursor, document.Size());
+    anchor = std::min(anchor, document.Size());
+    topLine = std::min(topLine, document.LineCount() - 1);
+    lineHeight = ImGui::GetTextLineHeight();
+    // Indexes of long lines are cheap to rebuild; don't let them pile up.
+    if (longLines.size() > MaxLongLines) longLines.clear();
+    float scrollbarHeight = wrap ? 0.0f : style.ScrollbarSize;
+    ImVec2 textSize(std::max(size.x - style.ScrollbarSize, 1.0f), std::max(size.y - scrollbarHeight, 1.0f));
+    visibleLines = std::max<size_t>(1, (size_t)((textSize.y - style.FramePadding.y * 2.0f) / lineHeight));
+    wrapWidth = std::max(textSize.x - style.FramePadding.x * 2.0f, ImGui::GetFontSize());
+    SyncWraps(document);
+
+    ImGui::PushID(id);
+    // Grouped so that SameLine() after the view lines up with its top.
+    ImGui::BeginGroup();
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    if (focusRequested) {
+        ImGui::SetKeyboardFocusHere();
+        focusRequested = false;
+    }
+    ImGui::InvisibleButton("##text", textSize);
+    focused = ImGui::IsItemFocused();
+    if (focused) {
+        ImGuiID owner = ImGui::GetItemID();
+        for (ImGuiKey key : OwnedKeys) ImGui::SetKeyOwner(key, owner);
+    }
+    HandleMouse(document, origin, textSize);
+    if (focused) HandleKeyboard(document, readOnly, edit);
+    if (scrollToCursor) EnsureCursorVisible(document, textSize.x - style.FramePadding.x * 2.0f);
+    Draw(document, origin, textSize);
+    RefineWraps(document);
+
+    ImGui::SameLine(0.0f, 0.0f);
+    RenderScrollbar(document, ImVec2(origin.x + textSize.x, origin.y), ImVec2(style.ScrollbarSize, textSize.y));
+    if (!wrap)
+        RenderHorizontalScrollbar(ImVec2(origin.x, origin.y + textSize.y), ImVec2(textSize.x, scrollbarHeight),
+            textSize.x - style.FramePadding.x * 2.0f);
+    ImGui::EndGroup();
+    ImGui::PopID();
+}
@@ -0,0 +1,81 @@
+#include "FileLoader.h"
+#include "PieceTable.h"
+#include "TextKernels.h"
+#include <algorithm>
+
+void FileLoader::Start(const std::string& path, size_t maxReadBytes) {
+    Cancel();
+    loadedBytes = 0;
+    totalBytes = 0;
+    running = true;
+    worker = std::thread(&FileLoader::Run, this, path, maxReadBytes);
+}
+
+void FileLoader::Cancel() {
+    cancelled = true;
+    if (worker.joinable()) worker.join();
+    cancelled = false;
+    running = false;
+    std::lock_guard<std::mutex> lock(mutex);
+    pending = Update();
+}
+
+bool FileLoader::Poll(Update& update) {
+    if (!running) return false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        update = std::move(pending);
+        pending = Update();
+    }
+    if (update.finished) {
+        worker.join();
+        running = false;
+    }
+    return update.file || !update.batches.empty() || update.finished;
+}
+
+void FileLoader::Run(std::string path, size_t maxReadBytes) {
+    std::string error;
+    std::shared_ptr<const MappedFile> file = MappedFile::Open(path, maxReadBytes, error);
+    if (!file) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.finished = true;
+            pending.error = error;
+        }
+        Notify();
+        return;
+    }
+    totalBytes = file->Size();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.path = path;
+        pending.file = file;
+    }
+    Notify();
+
+    const char* data = file->Data();
+    size_t size = file->Size();
+    size_t batchBytes = FirstBatch;
+    bool inWord = false;
+    for (size_t offset = 0; offset < size && !cancelled;) {
+        Batch batch;
+        batch.bytes = std::min(batchBytes, size - offset);
+        PieceTable::AppendChunked(batch.pieces, data + offset, batch.bytes);
+        batch.wordStarts = TextKernels::CountWordStarts(data + offset, batch.bytes, inWord);
+        offset += batch.bytes;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.batches.push_back(std::move(batch));
+        }
+        loadedBytes = offset;
+        Notify();
+        batchBytes = std::min(batchBytes * 2, MaxBatch);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.finished = true;
+    }
+    Notify();
+}
@@ -0,0 +1,235 @@
+#include "FileSearch.h"
+#include "MappedFile.h"
+#include "PieceTable.h"
+#include "TextKernels.h"
+#include "TextSearch.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+bool FileSearch::Start(const Options& options, std::string& error) {
+    Cancel();
+    if (options.query.empty()) {
+        error = "Nothing to find";
+        return false;
+    }
+    if (options.regex && !pattern.Compile(options.query, error)) return false;
+    std::error_code status;
+    fs::file_status root = fs::status(fs::u8path(options.root), status);
+    if (!fs::is_directory(root) && !fs::is_regular_file(root)) {
+        error = "Not a folder: " + options.root;
+        return false;
+    }
+    this->options = options;
+    cancelled = false;
+    finished = false;
+    filesSearched = filesSkipped = bytesSearched = matchCount = listed = 0;
+    unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < threads; i++) queues.push_back(std::make_unique<Queue>());
+    outstanding = 0;
+    // A single file is held to the same size limit as the files found in a folder.
+    if (fs::is_directory(root)) Push(0, Task{ options.root, true });
+    else if (fs::file_size(fs::u8path(options.root), status) > options.maxFileBytes) filesSkipped++;
+    else Push(0, Task{ options.root, false });
+    active = threads;
+    running = true;
+    for (unsigned i = 0; i < threads; i++) workers.emplace_back(&FileSearch::Run, this, i);
+    return true;
+}
+
+void FileSearch::Cancel() {
+    if (!workers.empty()) {
+        cancelled = true;
+        idle.notify_all();
+        for (std::thread& worker : workers) worker.join();
+        workers.clear();
+    }
+    queues.clear();
+    for (Node* node = incoming.exchange(nullptr); node;) {
+        Node* next = node->next;
+        delete node;
+        node = next;
+    }
+    running = false;
+}
+
+bool FileSearch::Poll(std::vector<FileResult>& results) {
+    if (!running) return false;
+    // Everything a worker delivers is pushed before the last one sets finished.
+    bool done = finished.load(std::memory_order_acquire);
+    Node* node = incoming.exchange(nullptr, std::memory_order_acquire);
+    bool arrived = node != nullptr;
+    Node* ordered = nullptr;
+    while (node) {
+        Node* next = node->next;
+        node->next = ordered;
+        ordered = node;
+        node = next;
+    }
+    while (ordered) {
+        Node* next = ordered->next;
+        results.push_back(std::move(ordered->result));
+        delete ordered;
+        ordered = next;
+    }
+    if (done) {
+        for (std::thread& worker : workers) worker.join();
+        workers.clear();
+        queues.clear();
+        running = false;
+    }
+    return arrived || done;
+}
+
+void FileSearch::Run(size_t worker) {
+    Regex regex = pattern;
+    regex.SetCancel(&cancelled);
+    Task task;
+    while (!cancelled) {
+        if (!Take(worker, task)) {
+            if (outstanding == 0) break;
+            // Another worker is still listing or searching; it may yet have tasks to steal.
+            std::unique_lock<std::mutex> lock(idleMutex);
+            idle.wait_for(lock, std::chrono::milliseconds(1));
+            continue;
+        }
+        if (task.directory) List(worker, task.path);
+        else Search(task.path, options.regex ? &regex : nullptr);
+        if (outstanding.fetch_sub(1) == 1) idle.notify_all();
+    }
+    if (active.fetch_sub(1) == 1) {
+        finished.store(true, std::memory_order_release);
+        Notify();
+    }
+}
+
+void FileSearch::Push(size_t worker, Task task) {
+    outstanding++;
+    {
+        std::lock_guard<std::mutex> lock(queues[worker]->mutex);
+        queues[worker]->tasks.push_back(std::move(task));
+    }
+    idle.notify_one();
+}
+
+// The newest task of the worker's own deque, or else the oldest of another's.
+bool FileSearch::Take(size_t worker, Task& task) {
+    {
+        Queue& own = *queues[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues.size(); i++) {
+        Queue& other = *queues[(worker + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if (!other.tasks.empty()) {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void FileSearch::List(size_t worker, const std::string& path) {
+    std::error_code error;
+    fs::directory_iterator it(fs::u8path(path), fs::directory_options::skip_permission_denied, error);
+    for (fs::directory_iterator end; !error && it != end && !cancelled; it.increment(error)) {
+        const fs::directory_entry& entry = *it;
+        std::error_code ignored;
+        // Links could lead out of the tree, or around in circles.
+        if (entry.is_symlink(ignored)) continue;
+        if (entry.is_directory(ignored)) {
+            std::string name = entry.path().filename().u8string();
+            if (name.empty() || name[0] != '.') Push(worker, Task{ entry.path().u8string(), true });
+        }
+        else if (entry.is_regular_file(ignored)) {
+            if (entry.file_size(ignored) > options.maxFileBytes) filesSkipped++;
+            else Push(worker, Task{ entry.path().u8string(), false });
+        }
+    }
+}
+
+void FileSearch::Search(const std::string& path, Regex* regex) {
+    std::string error;
+    std::shared_ptr<const MappedFile> file = MappedFile::Open(path, 0, error);
+    if (!file) {
+        filesSkipped++;
+        return;
+    }
+    const char* data = file->Data();
+    size_t size = file->Size();
+    if (memchr(data, 0, std::min(size, BinaryProbe))) {
+        filesSkipped++;
+        return;
+    }
+
+    FileResult result;
+    result.path = path;
+    size_t line = 0;
+    size_t counted = 0;     // newlines before here are in line
+    size_t lineEnd = 0;     // of the last matching line
+    auto add = [&](size_t offset) {
+        if (result.matches++ > 0 && offset <= lineEnd) return !cancelled;
+        line += TextKernels::CountNewlines(data + counted, offset - counted);
+        counted = offset;
+        size_t lineStart = offset;
+        while (lineStart > 0 && data[lineStart - 1] != '\n') lineStart--;
+        const char* newline = (const char*)memchr(data + offset, '\n', size - offset);
+        lineEnd = newline ? newline - data : size;
+        if (listed++ >= MaxListed) return !cancelled;
+
+        Line entry;
+        entry.line = line;
+        entry.column = offset - lineStart;
+        size_t from = lineStart, to = lineEnd;
+        if (to > from && data[to - 1] == '\r') to--;
+        if (to - from > MaxPreview) {
+            if (offset > from + PreviewContext) from = offset - PreviewContext;
+            to = std::min(to, from + MaxPreview);
+        }
+        entry.clipped = from > lineStart;
+        entry.preview.assign(data + from, to - from);
+        std::replace(entry.preview.begin(), entry.preview.end(), '\t', ' ');
+        result.lines.push_back(std::move(entry));
+        return !cancelled;
+    };
+    if (regex) {
+        // The regex reads documents; this one refers to the mapped bytes without copying.
+        PieceTable document;
+        document.BeginLoad(file);
+        std::vector<Piece> pieces;
+        PieceTable::AppendChunked(pieces, data, size);
+        document.AppendLoaded(pieces);
+        TextSearch::ForEachMatch(document, *regex, 0, size, [&](size_t offset, size_t) { return add(offset); });
+    }
+    else {
+        const std::string& needle = options.query;
+        for (size_t pos = 0; pos + needle.size() <= size;) {
+            size_t found = pos + TextKernels::FindSubstring(data + pos, size - pos, needle.data(), needle.size());
+            if (found >= size || !add(found)) break;
+            pos = found + needle.size();
+        }
+    }
+
+    filesSearched++;
+    bytesSearched += size;
+    if (result.matches > 0) {
+        matchCount += result.matches;
+        Deliver(std::move(result));
+    }
+}
+
+// Pushes onto the front of the incoming list; Poll takes the whole list at once.
+void FileSearch::Deliver(FileResult result) {
+    Node* node = new Node{ std::move(result), incoming.load(std::memory_order_relaxed) };
+    while (!incoming.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {}
+    Notify();
+}
@@ -0,0 +1,213 @@
+#include "FontSet.h"
+#include "AtomicFile.h"
+#include "EmbeddedFont.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+namespace {
+
+// Each size is at most about 1.4x the zoom levels it serves, which keeps downscaled text
+// sharp; UiSize is one of them so the UI is drawn unscaled.
+const float BakedSizes[] = { 12.0f, 16.0f, 20.0f, 28.0f, 36.0f, 48.0f };
+constexpr uint32_t BakedCount = sizeof(BakedSizes) / sizeof(BakedSizes[0]);
+
+// Cache file: header, then per font a record followed by its glyphs, then the alpha
+// texture. Bump CacheFormat when the layout changes.
+constexpr char CacheMagic[8] = { 'T', 'E', 'A', 'T', 'L', 'A', 'S', 0 };
+constexpr uint32_t CacheFormat = 1;
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t format;
+    uint32_t fontCount;
+    uint64_t key;
+    int32_t width;
+    int32_t height;
+    ImVec2 uvWhitePixel;
+    ImVec4 uvLines[IM_DRAWLIST_TEX_LINES_WIDTH_MAX + 1];
+};
+
+struct CacheFont {
+    float size;
+    float ascent;
+    float descent;
+    uint32_t fallbackChar;
+    uint32_t ellipsisChar;
+    uint32_t glyphCount;
+};
+
+uint64_t Fnv1a(uint64_t hash, const void* data, size_t length) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < length; i++) hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    return hash;
+}
+
+// Restore fills in ImFont and ImFontAtlas internals that ImGui 1.92 replaced with a new
+// font system; upgrading means porting it, and the cache key alone wouldn't catch that.
+static_assert(IMGUI_VERSION_NUM < 19200, "FontSet::Restore is written against ImGui 1.91's font internals");
+
+// Everything the rasterized atlas depends on: the font, the sizes, the glyph ranges, the
+// rasterizer settings, and the ImGui version and structure layouts the file is read into.
+uint64_t CacheKey(ImFontAtlas* atlas) {
+    uint64_t key = 0xcbf29ce484222325ull;
+    key = Fnv1a(key, RobotoFont_compressed_data, RobotoFont_compressed_size);
+    key = Fnv1a(key, BakedSizes, sizeof(BakedSizes));
+    const ImWchar* ranges = atlas->GetGlyphRangesDefault();
+    size_t count = 0;
+    while (ranges[count]) count++;
+    key = Fnv1a(key, ranges, count * sizeof(ImWchar));
+    ImFontConfig config;
+    const int settings[] = { config.OversampleH, config.OversampleV, config.PixelSnapH, atlas->TexGlyphPadding,
+        atlas->Flags, IMGUI_VERSION_NUM, (int)sizeof(ImFontGlyph), (int)sizeof(ImWchar) };
+    return Fnv1a(key, settings, sizeof(settings));
+}
+
+// The editor's directory under the per-user cache directory, created if needed; empty
+// if there is nowhere to put it.
+std::filesystem::path CacheDirectory() {
+    std::filesystem::path base;
+#ifdef _WIN32
+    if (const wchar_t* local = _wgetenv(L"LOCALAPPDATA")) base = local;
+#elif defined(__APPLE__)
+    if (const char* home = getenv("HOME")) base = std::filesystem::path(home) / "Library" / "Caches";
+#else
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    if (xdg && *xdg) base = xdg;
+    else if (const char* home = getenv("HOME")) base = std::filesystem::path(home) / ".cache";
+#endif
+    if (base.empty()) return base;
+    std::filesystem::path directory = base / "TextEditor";
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    return error ? std::filesystem::path() : directory;
+}
+
+}
+
+void FontSet::Load(ImFontAtlas* atlas) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    fonts.clear();
+    uint64_t key = CacheKey(atlas);
+    std::filesystem::path path = CacheDirectory();
+    if (!path.empty()) {
+        char name[32];
+        snprintf(name, sizeof(name), "atlas-%016llx.bin", (unsigned long long)key);
+        path /= name;
+    }
+
+    fromCache = !path.empty() && Restore(atlas, path, key);
+    if (!fromCache) {
+        for (float size : BakedSizes)
+            fonts.push_back(atlas->AddFontFromMemoryCompressedTTF(RobotoFont_compressed_data, RobotoFont_compressed_size, size));
+        atlas->Build();
+        if (!path.empty()) Save(atlas, path, key);
+    }
+    loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Rebuilds the fonts and texture from a cache file without rasterizing. The whole file is
+// checked before the atlas is touched, so a stale or damaged cache just means a cold start.
+bool FontSet::Restore(ImFontAtlas* atlas, const std::filesystem::path& path, uint64_t key) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    size_t pos = 0;
+    auto read = [&](void* out, size_t length) {
+        if (data.size() - pos < length) return false;
+        memcpy(out, data.data() + pos, length);
+        pos += length;
+        return true;
+    };
+
+    CacheHeader header;
+    if (!read(&header, sizeof(header)) || memcmp(header.magic, CacheMagic, sizeof(CacheMagic)) != 0 ||
+        header.format != CacheFormat || header.key != key || header.fontCount != BakedCount ||
+        header.width <= 0 || header.height <= 0)
+        return false;
+    std::vector<CacheFont> records(header.fontCount);
+    std::vector<std::vector<ImFontGlyph>> glyphs(header.fontCount);
+    for (uint32_t i = 0; i < header.fontCount; i++) {
+        if (!read(&records[i], sizeof(CacheFont)) || records[i].glyphCount == 0 ||
+            records[i].glyphCount > (data.size() - pos) / sizeof(ImFontGlyph))
+            return false;
+        glyphs[i].resize(records[i].glyphCount);
+        read(glyphs[i].data(), glyphs[i].size() * sizeof(ImFontGlyph));
+    }
+    size_t pixels = (size_t)header.width * header.height;
+    if (data.size() - pos != pixels) return false;
+
+    for (uint32_t i = 0; i < header.fontCount; i++) {
+        ImFont* font = IM_NEW(ImFont);
+        font->ContainerAtlas = atlas;
+        font->FontSize = records[i].size;
+        font->Ascent = records[i].ascent;
+        font->Descent = records[i].descent;
+        font->FallbackChar = (ImWchar)records[i].fallbackChar;
+        font->EllipsisChar = (ImWchar)records[i].ellipsisChar;
+        font->Glyphs.resize((int)glyphs[i].size());
+        memcpy(font->Glyphs.Data, glyphs[i].data(), glyphs[i].size() * sizeof(ImFontGlyph));
+        font->BuildLookupTable();
+        atlas->Fonts.push_back(font);
+        fonts.push_back(font);
+    }
+    atlas->TexWidth = header.width;
+    atlas->TexHeight = header.height;
+    atlas->TexUvScale = ImVec2(1.0f / header.width, 1.0f / header.height);
+    atlas->TexUvWhitePixel = header.uvWhitePixel;
+    memcpy(atlas->TexUvLines, header.uvLines, sizeof(header.uvLines));
+    atlas->TexPixelsAlpha8 = (unsigned char*)IM_ALLOC(pixels);
+    memcpy(atlas->TexPixelsAlpha8, data.data() + pos, pixels);
+    atlas->TexReady = true;
+    return true;
+}
+
+// Writes the built atlas to path and removes cache files left behind by other keys.
+// Failures are ignored; the next launch rasterizes again.
+void FontSet::Save(ImFontAtlas* atlas, const std::filesystem::path& path, uint64_t key) const {
+    unsigned char* pixels;
+    int width, height;
+    atlas->GetTexDataAsAlpha8(&pixels, &width, &height);
+
+    CacheHeader header = {};
+    memcpy(header.magic, CacheMagic, sizeof(CacheMagic));
+    header.format = CacheFormat;
+    header.fontCount = (uint32_t)fonts.size();
+    header.key = key;
+    header.width = width;
+    header.height = height;
+    header.uvWhitePixel = atlas->TexUvWhitePixel;
+    memcpy(header.uvLines, atlas->TexUvLines, sizeof(header.uvLines));
+
+    AtomicFile file;
+    std::string error;
+    if (!file.Open(path.u8string(), error)) return;
+    // AtomicFile keeps pointers until Finish, so the records must not move.
+    std::vector<CacheFont> records;
+    records.reserve(fonts.size());
+    file.Write((const char*)&header, sizeof(header));
+    for (ImFont* font : fonts) {
+        records.push_back(CacheFont{ font->FontSize, font->Ascent, font->Descent, font->FallbackChar,
+            font->EllipsisChar, (uint32_t)font->Glyphs.Size });
+        file.Write((const char*)&records.back(), sizeof(CacheFont));
+        file.Write((const char*)font->Glyphs.Data, font->Glyphs.Size * sizeof(ImFontGlyph));
+    }
+    file.Write((const char*)pixels, (size_t)width * height);
+    if (!file.Finish(error) || !file.Commit(error)) return;
+
+    std::error_code ignored;
+    for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(path.parent_path(), ignored)) {
+        std::string name = entry.path().filename().u8string();
+        if (name.compare(0, 6, "atlas-") == 0 && entry.path() != path) std::filesystem::remove(entry.path(), ignored);
+    }
+}
+
+ImFont* FontSet::ForSize(float size) const {
+    for (ImFont* font : fonts)
+        if (font->FontSize >= size) return font;
+    return fonts.back();
+}
@@ -0,0 +1,21 @@
+#include "FramePacer.h"
+#include <GLFW/glfw3.h>
+
+void FramePacer::WaitForFrame(double timeout) {
+    if (settle > 0 || timeout == 0.0) {
+        glfwPollEvents();
+        if (settle > 0) settle--;
+        return;
+    }
+    double start = glfwGetTime();
+    if (timeout < 0.0) glfwWaitEvents();
+    else glfwWaitEventsTimeout(timeout);
+    double waited = glfwGetTime() - start;
+    skipped += (size_t)(waited * refreshRate);
+    // Waking before the deadline means an event arrived rather than a timer running out.
+    if (timeout < 0.0 || waited < timeout) settle = SettleFrames;
+}
+
+void FramePacer::Wake() {
+    glfwPostEmptyEvent();
+}
@@ -0,0 +1,168 @@
+#include "IncrementalFind.h"
+#include "Regex.h"
+#include "TextSearch.h"
+#include <algorithm>
+#include <cstring>
+
+void IncrementalFind::Poll(const PieceTable& document, const std::string& text, bool isRegex) {
+    if (stale || document.Generation() != generation) {
+        Cancel();
+        cache.clear();
+        cachedOccurrences = 0;
+        generation = document.Generation();
+        stale = false;
+        complete = false;
+    }
+    if (text != query || isRegex != regex) {
+        Cancel();
+        query = text;
+        regex = isRegex;
+        complete = false;
+    }
+    if (running) {
+        bool adopted = false;
+        Entry entry;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ready) {
+                entry = std::move(result);
+                ready = false;
+                adopted = true;
+            }
+        }
+        if (adopted) {
+            worker.join();
+            running = false;
+            Adopt(std::move(entry));
+        }
+    }
+    if (complete || running) return;
+    if (query.empty()) {
+        count = 0;
+        complete = true;
+        return;
+    }
+    std::shared_ptr<const Entry> base;
+    if (!regex) {
+        // Counts for queries this one doesn't start with are no help any more.
+        while (!cache.empty() && query.compare(0, cache.back()->query.size(), cache.back()->query) != 0) {
+            if (cache.back()->occurrences) cachedOccurrences -= cache.back()->occurrences->size();
+            cache.pop_back();
+        }
+        if (!cache.empty() && cache.back()->query == query) {
+            count = cache.back()->count;
+            complete = true;
+            return;
+        }
+        if (!cache.empty() && cache.back()->occurrences &&
+            cache.back()->occurrences->size() <= document.Size() / BytesPerCheck)
+            base = cache.back();
+    }
+    Start(document, std::move(base));
+}
+
+void IncrementalFind::Start(const PieceTable& document, std::shared_ptr<const Entry> base) {
+    cancelled = false;
+    found = 0;
+    running = true;
+    worker = std::thread(&IncrementalFind::Run, this, document.TakeSnapshot(), query, regex, std::move(base));
+}
+
+void IncrementalFind::Cancel() {
+    if (!worker.joinable()) return;
+    cancelled = true;
+    worker.join();
+    running = false;
+    ready = false;
+}
+
+void IncrementalFind::Adopt(Entry entry) {
+    count = entry.count;
+    complete = true;
+    if (regex) return;
+    if (entry.occurrences) cachedOccurrences += entry.occurrences->size();
+    cache.push_back(std::make_shared<const Entry>(std::move(entry)));
+    // The shortest queries have the longest lists; they go first.
+    for (std::shared_ptr<const Entry>& cached : cache) {
+        if (cachedOccurrences <= MaxOccurrences) break;
+        if (!cached->occurrences) continue;
+        cachedOccurrences -= cached->occurrences->size();
+        cached = std::make_shared<const Entry>(Entry{ cached->query, cached->count, nullptr });
+    }
+}
+
+void IncrementalFind::Run(PieceTable::Snapshot snapshot, std::string pattern, bool isRegex, std::shared_ptr<const Entry> base) {
+    PieceTable text(std::move(snapshot));
+    Entry entry;
+    entry.query = pattern;
+    size_t matches = 0;
+    if (isRegex) {
+        Regex expression;
+        std::string error;
+        expression.SetCancel(&cancelled);
+        if (expression.Compile(pattern, error))
+            TextSearch::ForEachMatch(text, expression, 0, text.Size(), [&](size_t, size_t) {
+                found.store(++matches, std::memory_order_relaxed);
+                return !cancelled;
+            });
+    }
+    else {
+        std::shared_ptr<std::vector<size_t>> occurrences = std::make_shared<std::vector<size_t>>();
+        size_t n = pattern.size();
+        size_t next = 0;    // where the next match Find Next stops at may start
+        auto add = [&](size_t offset) {
+            if (occurrences) {
+                if (occurrences->size() < MaxOccurrences) occurrences->push_back(offset);
+                else occurrences.reset();
+            }
+            if (offset >= next) {
+                next = offset + n;
+                found.store(++matches, std::memory_order_relaxed);
+            }
+            return !cancelled;
+        };
+        if (base) {
+            // Each occurrence of the query is an occurrence of base's followed by the rest
+            // of it; those are checked in one walk over the spans they lie in.
+            const std::vector<size_t>& candidates = *base->occurrences;
+            size_t known = base->query.size();
+            const char* rest = pattern.data() + known;
+            size_t added = n - known;
+            size_t i = 0;
+            size_t spanStart = candidates.empty() ? text.Size() : candidates[0] + known;
+            if (spanStart < text.Size())
+                text.ForEachSpan(spanStart, text.Size() - spanStart, [&](const char* data, size_t size) {
+                    size_t spanEnd = spanStart + size;
+                    for (; i < candidates.size() && candidates[i] + known < spanEnd; i++) {
+                        size_t from = candidates[i] + known;
+                        bool match = from + added <= spanEnd ? memcmp(data + (from - spanStart), rest, added) == 0
+                            : from + added <= text.Size() && text.Read(from, added) == pattern.substr(known);
+                        if (match && !add(candidates[i])) return false;
+                    }
+                    spanStart = spanEnd;
+                    return i < candidates.size() && !cancelled;
+                });
+        }
+        else {
+            // A window at a time, so a query with few matches doesn't keep Cancel() waiting
+            // for the end of the document. Windows overlap by n - 1 bytes for the matches
+            // that cross into the next one.
+            for (size_t start = 0; start < text.Size() && !cancelled; start += ScanWindow) {
+                size_t end = std::min(start + ScanWindow, text.Size());
+                size_t limit = std::min(end + n - 1, text.Size());
+                TextSearch::ForEachOccurrence(text, pattern, start, limit - start, [&](size_t offset) {
+                    return offset < end && add(offset);
+                });
+            }
+        }
+        entry.occurrences = std::move(occurrences);
+    }
+    if (cancelled) return;
+    entry.count = matches;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        result = std::move(entry);
+        ready = true;
+    }
+    if (notify) notify();
+}
@@ -0,0 +1,150 @@
+#include "LayoutCache.h"
+#include <imgui_internal.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+float LineLayout::XAt(size_t column) const {
+    auto found = std::lower_bound(glyphs.begin(), glyphs.end(), column,
+        [](const Glyph& glyph, size_t value) { return glyph.offset < value; });
+    return found == glyphs.end() ? width : found->x;
+}
+
+size_t LineLayout::ColumnAt(float x) const {
+    // Last glyph starting at or before x; the boundary nearest to x is its start or its end.
+    auto after = std::upper_bound(glyphs.begin(), glyphs.end(), x,
+        [](float value, const Glyph& glyph) { return value < glyph.x; });
+    if (after == glyphs.begin()) return 0;
+    const Glyph& glyph = *(after - 1);
+    float right = after == glyphs.end() ? width : after->x;
+    if (x < (glyph.x + right) * 0.5f) return glyph.offset;
+    return after == glyphs.end() ? bytes : after->offset;
+}
+
+void LineLayout::Draw(ImDrawList* drawList, const ImVec2& pos, float clipLeft, float clipRight, ImU32 color,
+    size_t begin, size_t end) const {
+    // Same rounding as ImFont::RenderText, so cached and uncached text line up.
+    float left = std::floor(pos.x);
+    float top = std::floor(pos.y);
+    auto rangeBegin = glyphs.begin() + std::min(begin, glyphs.size());
+    auto rangeEnd = glyphs.begin() + std::min(end, glyphs.size());
+    // Glyphs can overhang their advance a little, so start one early.
+    auto first = std::upper_bound(rangeBegin, rangeEnd, clipLeft - left,
+        [](float value, const Glyph& glyph) { return value < glyph.x; });
+    if (first != rangeBegin) --first;
+    if (first != rangeBegin) --first;
+    auto last = std::upper_bound(first, rangeEnd, clipRight - left,
+        [](float value, const Glyph& glyph) { return value < glyph.x; });
+    if (first == last) return;
+
+    int reserved = (int)(last - first);
+    drawList->PrimReserve(reserved * 6, reserved * 4);
+    int used = 0;
+    for (auto it = first; it != last; ++it) {
+        const ImFontGlyph* glyph = it->glyph;
+        if (!glyph) continue;
+        float x = left + it->x;
+        ImU32 glyphColor = glyph->Colored ? (color | ~IM_COL32_A_MASK) : color;
+        drawList->PrimRectUV(ImVec2(x + glyph->X0 * scale, top + glyph->Y0 * scale),
+            ImVec2(x + glyph->X1 * scale, top + glyph->Y1 * scale),
+            ImVec2(glyph->U0, glyph->V0), ImVec2(glyph->U1, glyph->V1), glyphColor);
+        used++;
+    }
+    drawList->PrimUnreserve((reserved - used) * 6, (reserved - used) * 4);
+}
+
+std::vector<uint32_t> LineLayout::Wrap(const std::string& text, float wrapWidth) const {
+    std::vector<uint32_t> rows(1, 0);
+    size_t rowStart = 0;
+    size_t breakAt = 0;     // glyph after the last space in the row
+    float rowLeft = 0.0f;
+    for (size_t i = 0; i < glyphs.size(); i++) {
+        char c = text[glyphs[i].offset];
+        // Spaces may hang past the edge, so a row never starts with the one it broke at.
+        if (c == ' ' || c == '\t') {
+            breakAt = i + 1;
+            continue;
+        }
+        float right = i + 1 < glyphs.size() ? glyphs[i + 1].x : width;
+        // Break after the last space, or mid-word when a word is wider than the row.
+        while (right - rowLeft > wrapWidth && i > rowStart) {
+            rowStart = breakAt > rowStart ? breakAt : i;
+            rows.push_back((uint32_t)rowStart);
+            rowLeft = glyphs[rowStart].x;
+        }
+    }
+    return rows;
+}
+
+uint64_t LayoutCache::Key(const std::string& text, ImFont* font, float fontSize) {
+    uint64_t key = std::hash<std::string_view>()(std::string_view(text));
+    uint32_t sizeBits;
+    memcpy(&sizeBits, &fontSize, sizeof(sizeBits));
+    key ^= std::hash<const void*>()(font) + 0x9e3779b97f4a7c15ull + (key << 6) + (key >> 2);
+    key ^= sizeBits + 0x9e3779b97f4a7c15ull + (key << 6) + (key >> 2);
+    return key;
+}
+
+std::shared_ptr<LineLayout> LayoutCache::Build(const std::string& text, ImFont* font, float fontSize) {
+    auto layout = std::make_shared<LineLayout>();
+    layout->bytes = text.size();
+    layout->scale = fontSize / font->FontSize;
+    layout->glyphs.reserve(text.size());
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    float x = 0.0f;
+    for (const char* s = begin; s < end;) {
+        unsigned int c = (unsigned char)*s;
+        int length = 1;
+        if (c >= 0x80) length = std::max(1, ImTextCharFromUtf8(&c, s, end));
+        // Carriage returns take no space, as in ImFont::RenderText.
+        const ImFontGlyph* glyph = c == '\r' ? nullptr : font->FindGlyph((ImWchar)c);
+        layout->glyphs.push_back(LineLayout::Glyph{ x, (uint32_t)(s - begin), glyph && glyph->Visible ? glyph : nullptr });
+        if (glyph) x += glyph->AdvanceX * layout->scale;
+        s += length;
+    }
+    layout->width = x;
+    return layout;
+}
+
+std::shared_ptr<const LineLayout> LayoutCache::Get(const std::string& text, ImFont* font, float fontSize) {
+    uint64_t key = Key(text, font, fontSize);
+    auto found = index.find(key);
+    if (found != index.end()) {
+        Entry& entry = *found->second;
+        if (entry.font == font && entry.fontSize == fontSize && entry.text == text) {
+            hits++;
+            entries.splice(entries.begin(), entries, found->second);
+            return entry.layout;
+        }
+        Remove(found->second);
+    }
+    misses++;
+    std::shared_ptr<LineLayout> layout = Build(text, font, fontSize);
+    size_t cost = sizeof(Entry) + sizeof(LineLayout) + text.capacity() +
+        layout->glyphs.capacity() * sizeof(LineLayout::Glyph);
+    entries.push_front(Entry{ key, text, font, fontSize, layout, cost });
+    index[key] = entries.begin();
+    memoryUsed += cost;
+    Trim();
+    return layout;
+}
+
+void LayoutCache::Remove(EntryList::iterator entry) {
+    memoryUsed -= entry->cost;
+    index.erase(entry->key);
+    entries.erase(entry);
+}
+
+void LayoutCache::Trim() {
+    // The newest entry stays even if it alone is over budget; it is about to be drawn.
+    while (memoryUsed > budget && entries.size() > 1) Remove(std::prev(entries.end()));
+}
+
+void LayoutCache::Clear() {
+    entries.clear();
+    index.clear();
+    memoryUsed = 0;
+}
@@ -0,0 +1,99 @@
+#include "LineSegments.h"
+#include <algorithm>
+
+void LineSegments::Reset(size_t lineStart, size_t lineLength, double estimate) {
+    start = lineStart;
+    length = lineLength;
+    size_t count = std::max<size_t>(1, (lineLength + SegmentBytes - 1) / SegmentBytes);
+    widths.assign(count, estimate);
+    measured.assign(count, false);
+    tree.assign(count + 1, 0.0);
+    for (size_t i = 1; i <= count; i++) {
+        tree[i] += estimate;
+        size_t parent = i + (i & (0 - i));
+        if (parent <= count) tree[parent] += tree[i];
+    }
+    total = estimate * count;
+    // Row counts are of the old text.
+    rowWidth = 0.0f;
+    rows.clear();
+    rowTree.clear();
+    totalRows = 0;
+}
+
+void LineSegments::SetWidth(size_t segment, double width) {
+    double delta = width - widths[segment];
+    widths[segment] = width;
+    measured[segment] = true;
+    if (delta == 0.0) return;
+    for (size_t i = segment + 1; i < tree.size(); i += i & (0 - i)) tree[i] += delta;
+    total += delta;
+}
+
+double LineSegments::XOf(size_t segment) const {
+    double x = 0.0;
+    for (size_t i = segment; i > 0; i -= i & (0 - i)) x += tree[i];
+    return x;
+}
+
+size_t LineSegments::SegmentAt(double x) const {
+    // Largest prefix of segments that ends at or before x.
+    size_t count = widths.size();
+    size_t segment = 0;
+    size_t step = 1;
+    while (step * 2 <= count) step *= 2;
+    for (; step > 0; step /= 2) {
+        if (segment + step <= count && tree[segment + step] <= x) {
+            segment += step;
+            x -= tree[segment];
+        }
+    }
+    return std::min(segment, count - 1);
+}
+
+void LineSegments::ResetRows(float width, size_t estimate) {
+    size_t count = widths.size();
+    rowWidth = width;
+    rows.assign(count, (uint32_t)estimate);
+    rowTree.assign(count + 1, 0);
+    for (size_t i = 1; i <= count; i++) {
+        rowTree[i] += estimate;
+        size_t parent = i + (i & (0 - i));
+        if (parent <= count) rowTree[parent] += rowTree[i];
+    }
+    totalRows = (uint64_t)estimate * count;
+}
+
+void LineSegments::SetRows(size_t segment, size_t count) {
+    int64_t delta = (int64_t)count - (int64_t)rows[segment];
+    rows[segment] = (uint32_t)count;
+    if (delta == 0) return;
+    for (size_t i = segment + 1; i < rowTree.size(); i += i & (0 - i)) rowTree[i] += delta;
+    totalRows += delta;
+}
+
+uint64_t LineSegments::RowOf(size_t segment) const {
+    uint64_t row = 0;
+    for (size_t i = segment; i > 0; i -= i & (0 - i)) row += rowTree[i];
+    return row;
+}
+
+size_t LineSegments::SegmentAtRow(uint64_t row, size_t& rowInSegment) const {
+    size_t count = rows.size();
+    size_t segment = 0;
+    size_t step = 1;
+    while (step * 2 <= count) step *= 2;
+    for (; step > 0; step /= 2) {
+        if (segment + step <= count && rowTree[segment + step] <= row) {
+            segment += step;
+            row -= rowTree[segment];
+        }
+    }
+    if (segment >= count) {
+        // Past the last row.
+        segment = count - 1;
+        row = rows[segment] - 1;
+    }
+    rowInSegment = (size_t)row;
+    return segment;
+}
@@ -0,0 +1,114 @@
+#include "MappedFile.h"
+#include <algorithm>
+#include <cstdio>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+static std::wstring Widen(const std::string& path) {
+    int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+    std::wstring wide(length > 0 ? length - 1 : 0, L'\0');
+    if (length > 1) MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wide[0], length);
+    return wide;
+}
+#endif
+
+MappedFile::~MappedFile() {
+    if (!mapped) return;
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+    CloseHandle((HANDLE)mapping);
+#else
+    munmap((void*)data, size);
+#endif
+}
+
+std::unique_ptr<MappedFile> MappedFile::Open(const std::string& path, size_t maxReadBytes, std::string& error) {
+    std::unique_ptr<MappedFile> file(new MappedFile());
+    if (file->Map(path, error)) return file;
+    if (!error.empty()) return nullptr;
+    if (file->Read(path, maxReadBytes, error)) return file;
+    return nullptr;
+}
+
+std::unique_ptr<MappedFile> MappedFile::FromMemory(std::string text) {
+    std::unique_ptr<MappedFile> file(new MappedFile());
+    file->heap = std::move(text);
+    file->data = file->heap.data();
+    file->size = file->heap.size();
+    return file;
+}
+
+// Returns false with an empty error when the file exists but can't be mapped.
+bool MappedFile::Map(const std::string& path, std::string& error) {
+#ifdef _WIN32
+    HANDLE handle = CreateFileW(Widen(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) { error = "Could not open file"; return false; }
+    LARGE_INTEGER fileSize;
+    if (GetFileType(handle) != FILE_TYPE_DISK || !GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(handle);
+        return false;
+    }
+    HANDLE section = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(handle);
+    if (!section) return false;
+    void* view = MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0);
+    if (!view) { CloseHandle(section); return false; }
+    data = (const char*)view;
+    size = (size_t)fileSize.QuadPart;
+    mapping = section;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) { error = "Could not open file"; return false; }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return false;
+    data = (const char*)view;
+    size = (size_t)info.st_size;
+#endif
+    mapped = true;
+    return true;
+}
+
+// Fallback for inputs without a mappable size: read to EOF in chunks.
+bool MappedFile::Read(const std::string& path, size_t maxReadBytes, std::string& error) {
+#ifdef _WIN32
+    FILE* file = _wfopen(Widen(path).c_str(), L"rb");
+#else
+    FILE* file = fopen(path.c_str(), "rb");
+#endif
+    if (!file) { error = "Could not open file"; return false; }
+    const size_t chunk = 1024 * 1024;
+    size_t length = 0;
+    for (;;) {
+        if (heap.size() < length + chunk) heap.resize(std::max(heap.size() * 2, length + chunk));
+        size_t count = fread(&heap[length], 1, chunk, file);
+        length += count;
+        if (length > maxReadBytes) { error = "File exceeds the memory budget"; break; }
+        if (count < chunk) {
+            if (ferror(file)) error = "Could not read file";
+            break;
+        }
+    }
+    fclose(file);
+    if (!error.empty()) { heap.clear(); return false; }
+    heap.resize(length);
+    data = heap.data();
+    size = heap.size();
+    return true;
+}
@@ -0,0 +1,220 @@
+#include "Minimap.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+void Minimap::CountSpan(const char* data, size_t length, size_t& column, uint32_t* row, int sign) {
+    const size_t limit = Columns * CharsPerTexel;
+    for (size_t i = 0; i < length && column < limit; i++) {
+        unsigned char c = (unsigned char)data[i];
+        if (c == '\t') {
+            column = (column / 4 + 1) * 4;
+            continue;
+        }
+        if ((c & 0xC0) == 0x80) continue;
+        if (c != ' ' && c != '\r') {
+            uint32_t& texel = row[column / CharsPerTexel];
+            // Patches can disagree with the build about which row a line is in; never wrap.
+            if (sign > 0) texel++;
+            else if (texel > 0) texel--;
+        }
+        column++;
+    }
+}
+
+Minimap::Counts Minimap::Layout(size_t lineCount) {
+    Counts counts;
+    counts.linesPerRow = (lineCount + MaxRows - 1) / MaxRows;
+    size_t rows = (lineCount + counts.linesPerRow - 1) / counts.linesPerRow;
+    counts.texels.assign(rows * Columns, 0);
+    counts.lines.resize(rows);
+    for (size_t row = 0; row < rows; row++)
+        counts.lines[row] = (uint32_t)std::min(counts.linesPerRow, lineCount - row * counts.linesPerRow);
+    return counts;
+}
+
+bool Minimap::Poll(const PieceTable& document) {
+    // A build of a document that has since been replaced is of no use.
+    if (running && document.Generation() != generation) Cancel();
+    bool adopted = false;
+    if (running) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (ready) {
+            texels = std::move(result.texels);
+            rowLines = std::move(result.lines);
+            linesPerRow = result.linesPerRow;
+            ready = false;
+            adopted = true;
+        }
+    }
+    if (adopted) {
+        worker.join();
+        running = false;
+        pixels.assign(texels.size(), 0);
+        UpdatePixels(0, rowLines.size());
+    }
+    if (!running && (stale || document.Generation() != generation)) Start(document);
+    return adopted;
+}
+
+void Minimap::Start(const PieceTable& document) {
+    generation = document.Generation();
+    stale = false;
+    cancelled = false;
+    running = true;
+    worker = std::thread(&Minimap::Run, this, document.TakeSnapshot());
+}
+
+void Minimap::Cancel() {
+    if (!worker.joinable()) return;
+    cancelled = true;
+    worker.join();
+    running = false;
+    ready = false;
+}
+
+void Minimap::Run(PieceTable::Snapshot snapshot) {
+    Counts counts = Layout(snapshot.LineCount());
+    size_t rows = counts.lines.size();
+    size_t line = 0;
+    size_t column = 0;
+    uint32_t* row = counts.texels.data();
+    snapshot.pieces.ForEachPiece(0, [&](const Piece& piece) {
+        const char* data = piece.data;
+        const char* end = data + piece.length;
+        for (size_t newlines = piece.newlines; newlines > 0; newlines--) {
+            const char* newline = (const char*)memchr(data, '\n', end - data);
+            CountSpan(data, newline - data, column, row, 1);
+            line++;
+            column = 0;
+            row = counts.texels.data() + std::min(line / counts.linesPerRow, rows - 1) * Columns;
+            data = newline + 1;
+        }
+        CountSpan(data, end - data, column, row, 1);
+        return !cancelled;
+    });
+    if (cancelled) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        result = std::move(counts);
+        ready = true;
+    }
+    if (notify) notify();
+}
+
+void Minimap::BeforeEdit(const PieceTable& document, size_t line, size_t lines) {
+    patching = !rowLines.empty() && lines <= MaxPatchLines;
+    if (!patching) {
+        stale = true;
+        return;
+    }
+    size_t rowStart;
+    size_t row = RowOf(line, rowStart);
+    size_t rowEnd = rowStart + rowLines[row];   // as it was before the edit
+    editRow = touchedFirst = row;
+    for (size_t i = line; i < line + lines && i < document.LineCount(); i++) {
+        while (i >= rowEnd && row + 1 < rowLines.size()) rowEnd += rowLines[++row];
+        CountLine(document, i, row, -1);
+        if (rowLines[row] > 0) rowLines[row]--;
+    }
+    touchedEnd = row + 1;
+}
+
+void Minimap::AfterEdit(const PieceTable& document, size_t line, size_t lines) {
+    // A build in progress may have read the text from before the edit.
+    if (running) stale = true;
+    bool patched = patching;
+    patching = false;
+    if (!patched || lines > MaxPatchLines) {
+        stale = true;
+        return;
+    }
+    for (size_t i = line; i < line + lines && i < document.LineCount(); i++) {
+        CountLine(document, i, editRow, 1);
+        rowLines[editRow]++;
+    }
+    UpdatePixels(touchedFirst, touchedEnd);
+    for (size_t row = touchedFirst; row < touchedEnd; row++)
+        if (Uneven(row)) stale = true;
+    if ((document.LineCount() + MaxRows - 1) / MaxRows != linesPerRow) stale = true;
+}
+
+size_t Minimap::RowOf(size_t line, size_t& rowStart) const {
+    rowStart = 0;
+    for (size_t row = 0; row + 1 < rowLines.size(); row++) {
+        if (line < rowStart + rowLines[row]) return row;
+        rowStart += rowLines[row];
+    }
+    return rowLines.size() - 1;
+}
+
+void Minimap::CountLine(const PieceTable& document, size_t line, size_t row, int sign) {
+    size_t start = document.LineStart(line);
+    std::string text = document.Read(start, std::min(document.LineEnd(line) - start, MaxScanBytes));
+    size_t column = 0;
+    CountSpan(text.data(), text.size(), column, texels.data() + row * Columns, sign);
+}
+
+bool Minimap::Uneven(size_t row) const {
+    // The last row holds whatever is left over, so only too many lines count there.
+    return rowLines[row] > 2 * linesPerRow || (row + 1 < rowLines.size() && 2 * rowLines[row] < linesPerRow);
+}
+
+void Minimap::UpdatePixels(size_t first, size_t end) {
+    for (size_t row = first; row < end; row++) {
+        double capacity = (double)std::max<uint32_t>(rowLines[row], 1) * CharsPerTexel;
+        for (size_t column = 0; column < (size_t)Columns; column++) {
+            double density = std::min(texels[row * Columns + column] / capacity, 1.0);
+            // The square root keeps sparse text visible when many lines share a row.
+            uint32_t alpha = (uint32_t)std::lround(std::sqrt(density) * 255.0);
+            pixels[row * Columns + column] = IM_COL32(255, 255, 255, alpha);
+        }
+    }
+    if (dirtyFirst >= dirtyEnd) {
+        dirtyFirst = first;
+        dirtyEnd = end;
+    }
+    else {
+        dirtyFirst = std::min(dirtyFirst, first);
+        dirtyEnd = std::max(dirtyEnd, end);
+    }
+}
+
+bool Minimap::TakeDirty(int& first, int& end) {
+    if (dirtyFirst >= dirtyEnd) return false;
+    first = (int)dirtyFirst;
+    end = (int)dirtyEnd;
+    dirtyFirst = dirtyEnd = 0;
+    return true;
+}
+
+bool Minimap::Render(const char* id, ImTextureID texture, const ImVec2& size, size_t topLine, size_t visibleLines,
+    size_t lineCount, size_t& scrollTo) {
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImGui::InvisibleButton(id, size);
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    ImVec2 max(origin.x + size.x, origin.y + size.y);
+    drawList->AddRectFilled(origin, max, ImGui::GetColorU32(ImGuiCol_FrameBg));
+
+    // Lines map linearly onto the strip, so a position is a line in O(1) either way.
+    float height = std::min(size.y, (float)(lineCount * MaxLineHeight));
+    auto yOf = [&](size_t line) { return origin.y + (float)((double)line / lineCount * height); };
+    if (texture && !pixels.empty()) {
+        // The last row may be partly filled; only the part holding lines is stretched.
+        double lastRow = std::min((double)rowLines.back() / linesPerRow, 1.0);
+        float v = (float)((rowLines.size() - 1 + lastRow) / rowLines.size());
+        drawList->AddImage(texture, origin, ImVec2(max.x, origin.y + height), ImVec2(0.0f, 0.0f), ImVec2(1.0f, v),
+            ImGui::GetColorU32(ImGuiCol_Text));
+    }
+    float top = yOf(topLine);
+    float bottom = std::max(yOf(topLine + visibleLines), top + 2.0f);
+    drawList->AddRectFilled(ImVec2(origin.x, top), ImVec2(max.x, bottom), ImGui::GetColorU32(ImGuiCol_ScrollbarGrab, 0.5f));
+
+    if (!ImGui::IsItemActive() || height <= 0.0f) return false;
+    double t = std::min(std::max((ImGui::GetIO().MousePos.y - origin.y) / (double)height, 0.0), 1.0);
+    size_t line = std::min((size_t)(t * lineCount), lineCount - 1);
+    // The line under the mouse goes to the middle of the view.
+    scrollTo = line - std::min(line, visibleLines / 2);
+    return true;
+}
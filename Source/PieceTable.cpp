@@ -0,0 +1,330 @@
+#include "PieceTable.h"
+#include "AtomicFile.h"
+#include "TextKernels.h"
+
+using TextKernels::CountNewlines;
+
+// Sub-range [from, to) of a piece; newlines are counted on the shorter side.
+Piece PieceTable::Slice(const Piece& piece, size_t from, size_t to) const {
+    Piece slice{ piece.data + from, to - from, 0 };
+    if (slice.length * 2 < piece.length) slice.newlines = CountNewlines(slice.data, slice.length);
+    else slice.newlines = piece.newlines - CountNewlines(piece.data, from) - CountNewlines(piece.data + to, piece.length - to);
+    return slice;
+}
+
+void PieceTable::AppendChunked(std::vector<Piece>& out, const char* data, size_t length) {
+    for (size_t offset = 0; offset < length; offset += Rope::MaxChunk) {
+        size_t count = std::min(Rope::MaxChunk, length - offset);
+        out.push_back(Piece{ data + offset, count, CountNewlines(data + offset, count) });
+    }
+}
+
+const char* PieceTable::Append(const char* text, size_t length) {
+    if (addUsed + length > addCapacity) {
+        // Blocks double in size up to MaxAddBlock; a larger insert gets a block of its own.
+        size_t capacity = std::max(length, std::min(std::max(addCapacity * 2, MinAddBlock), MaxAddBlock));
+        if (memoryUsed + capacity > memoryBudget) {
+            capacity = length;
+            if (memoryUsed + capacity > memoryBudget) return nullptr;
+        }
+        addBlocks.emplace_back(new char[capacity]);
+        memoryUsed += capacity;
+        addCapacity = capacity;
+        addUsed = 0;
+    }
+    char* dest = addBlocks.back().get() + addUsed;
+    std::copy(text, text + length, dest);
+    addUsed += length;
+    return dest;
+}
+
+// Keeps chunks between MinChunk and MaxChunk around an edit: a small piece is folded
+// into the piece before it by copying both into the add buffer.
+void PieceTable::Compact(std::vector<Piece>& run) {
+    char joined[Rope::MaxChunk];
+    for (size_t i = 1; i < run.size();) {
+        Piece& left = run[i - 1];
+        const Piece& right = run[i];
+        if (right.length >= Rope::MinChunk || left.length + right.length > Rope::MaxChunk) { i++; continue; }
+        std::copy(left.data, left.data + left.length, joined);
+        std::copy(right.data, right.data + right.length, joined + left.length);
+        const char* data = Append(joined, left.length + right.length);
+        if (!data) { i++; continue; }
+        left = Piece{ data, left.length + right.length, left.newlines + right.newlines };
+        run.erase(run.begin() + i);
+    }
+}
+
+void PieceTable::Reset(std::shared_ptr<const MappedFile> file) {
+    BeginLoad(std::move(file));
+    std::vector<Piece> pieces;
+    AppendChunked(pieces, original->Data(), original->Size());
+    rope.Assign(pieces);
+}
+
+void PieceTable::BeginLoad(std::shared_ptr<const MappedFile> file) {
+    original = std::move(file);
+    generation++;
+    addBlocks.clear();
+    addUsed = addCapacity = 0;
+    memoryUsed = original->IsMapped() ? 0 : original->Size();
+    rope.Clear();
+}
+
+void PieceTable::AppendLoaded(const std::vector<Piece>& pieces) {
+    rope.Splice(rope.PieceCount(), 0, pieces.data(), pieces.size());
+}
+
+void PieceTable::Load(std::string text) {
+    Reset(MappedFile::FromMemory(std::move(text)));
+}
+
+bool PieceTable::LoadFile(const std::string& path, std::string& error) {
+    std::unique_ptr<MappedFile> file = MappedFile::Open(path, memoryBudget, error);
+    if (!file) return false;
+    Reset(std::move(file));
+    return true;
+}
+
+bool PieceTable::SaveFile(const std::string& path, std::string& error) {
+    AtomicFile file;
+    if (!file.Open(path, error)) return false;
+    ForEachSpan([&](const char* data, size_t length) { return file.Write(data, length); });
+    if (!file.Finish(error)) return false;
+    // The original may be the file being replaced. Its mapping outlives the rename (on
+    // Windows, AtomicFile moves the mapped file aside first), so the document's pieces,
+    // and the undo history that refers to them, stay valid.
+    return file.Commit(error);
+}
+
+bool PieceTable::Insert(size_t pos, const char* text, size_t length) {
+    if (length == 0) return true;
+    pos = std::min(pos, Size());
+
+    const char* tail = addBlocks.empty() ? nullptr : addBlocks.back().get() + addUsed;
+    const char* added = Append(text, length);
+    if (!added) return false;
+
+    Rope::Position at = rope.FindOffset(pos);
+
+    // Typing at the end of the previous insertion just grows that piece.
+    if (pos == at.offset && at.index > 0 && added == tail) {
+        Piece prev = rope.PieceAt(at.index - 1);
+        if (prev.data + prev.length == tail && prev.length + length <= Rope::MaxChunk) {
+            prev.length += length;
+            prev.newlines += CountNewlines(text, length);
+            rope.Splice(at.index - 1, 1, &prev, 1);
+            return true;
+        }
+    }
+
+    std::vector<Piece> pieces;
+    AppendChunked(pieces, added, length);
+    InsertPieces(pos, pieces);
+    return true;
+}
+
+void PieceTable::InsertPieces(size_t pos, const std::vector<Piece>& pieces) {
+    if (pieces.empty()) return;
+    pos = std::min(pos, Size());
+    Rope::Position at = rope.FindOffset(pos);
+
+    // Rebuild the run [previous piece, split target...] around the new pieces.
+    std::vector<Piece> run;
+    size_t first = at.index;
+    size_t removed = 0;
+    if (at.index > 0) {
+        first--;
+        removed++;
+        run.push_back(rope.PieceAt(first));
+    }
+    bool inside = at.index < rope.PieceCount() && pos > at.offset;
+    if (inside) run.push_back(Slice(at.piece, 0, pos - at.offset));
+    run.insert(run.end(), pieces.begin(), pieces.end());
+    if (inside) {
+        run.push_back(Slice(at.piece, pos - at.offset, at.piece.length));
+        removed++;
+    }
+    Compact(run);
+    rope.Splice(first, removed, run.data(), run.size());
+}
+
+void PieceTable::Erase(size_t pos, size_t length) {
+    if (pos >= Size() || length == 0) return;
+    length = std::min(length, Size() - pos);
+    size_t end = pos + length;
+
+    Rope::Position first = rope.FindOffset(pos);
+    Rope::Position last = rope.FindOffset(end - 1);
+
+    std::vector<Piece> run;
+    size_t index = first.index;
+    if (index > 0) {
+        index--;
+        run.push_back(rope.PieceAt(index));
+    }
+    if (pos > first.offset) run.push_back(Slice(first.piece, 0, pos - first.offset));
+    size_t lastEnd = last.offset + last.piece.length;
+    if (end < lastEnd) run.push_back(Slice(last.piece, end - last.offset, last.piece.length));
+    size_t removed = last.index + 1 - index;
+    if (last.index + 1 < rope.PieceCount()) {
+        run.push_back(rope.PieceAt(last.index + 1));
+        removed++;
+    }
+    Compact(run);
+    rope.Splice(index, removed, run.data(), run.size());
+}
+
+bool PieceTable::ReplaceRanges(const std::vector<std::pair<size_t, size_t>>& ranges, const char* text, size_t length) {
+    if (ranges.empty()) return true;
+    size_t first = std::min(ranges.front().first, Size());
+    size_t last = std::min(ranges.back().first + ranges.back().second, Size());
+    std::vector<Piece> old = PiecesIn(first, last - first);
+
+    // Copied bytes collect in pending and go to the add buffer a chunk at a time.
+    std::vector<Piece> run;
+    std::string pending;
+    pending.reserve(Rope::MaxChunk);
+    auto flush = [&] {
+        if (pending.empty()) return true;
+        const char* data = Append(pending.data(), pending.size());
+        if (!data) return false;
+        run.push_back(Piece{ data, pending.size(), CountNewlines(data, pending.size()) });
+        pending.clear();
+        return true;
+    };
+    auto copy = [&](const char* data, size_t count) {
+        while (count > 0) {
+            size_t part = std::min(count, Rope::MaxChunk - pending.size());
+            pending.append(data, part);
+            data += part;
+            count -= part;
+            if (pending.size() == Rope::MaxChunk && !flush()) return false;
+        }
+        return true;
+    };
+    // Keeps [pos, end) of the old text. A slice shorter than MinChunk is copied instead,
+    // and a short pending chunk is topped up first, so the new pieces stay chunk-sized.
+    size_t index = 0;
+    size_t pieceStart = first;
+    auto keep = [&](size_t pos, size_t end) {
+        while (pos < end) {
+            while (pieceStart + old[index].length <= pos) pieceStart += old[index++].length;
+            const Piece& piece = old[index];
+            size_t from = pos - pieceStart;
+            size_t to = std::min(piece.length, end - pieceStart);
+            pos = pieceStart + to;
+            if (!pending.empty() && pending.size() < Rope::MinChunk) {
+                size_t part = std::min(to - from, Rope::MinChunk - pending.size());
+                if (!copy(piece.data + from, part)) return false;
+                from += part;
+            }
+            if (to - from < Rope::MinChunk) {
+                if (!copy(piece.data + from, to - from)) return false;
+                continue;
+            }
+            if (!flush()) return false;
+            run.push_back(from == 0 && to == piece.length ? piece : Slice(piece, from, to));
+        }
+        return true;
+    };
+
+    size_t pos = first;
+    for (const std::pair<size_t, size_t>& range : ranges) {
+        if (!keep(pos, std::min(range.first, last)) || !copy(text, length)) return false;
+        pos = std::min(range.first + range.second, last);
+    }
+    if (!flush()) return false;
+
+    // Splice the run in place of the pieces [first, last) touches, keeping their parts
+    // outside it, with a neighbour on each side for Compact, as Erase does.
+    Rope::Position head = rope.FindOffset(first);
+    std::vector<Piece> spliced;
+    size_t at = head.index;
+    size_t removed = 0;
+    if (at > 0) {
+        at--;
+        removed++;
+        spliced.push_back(rope.PieceAt(at));
+    }
+    bool inside = head.index < rope.PieceCount() && first > head.offset;
+    if (inside) spliced.push_back(Slice(head.piece, 0, first - head.offset));
+    spliced.insert(spliced.end(), run.begin(), run.end());
+    size_t next = head.index;
+    if (last > first) {
+        Rope::Position tail = rope.FindOffset(last - 1);
+        if (last < tail.offset + tail.piece.length) spliced.push_back(Slice(tail.piece, last - tail.offset, tail.piece.length));
+        next = tail.index + 1;
+    }
+    else if (inside) {
+        spliced.push_back(Slice(head.piece, first - head.offset, head.piece.length));
+        next = head.index + 1;
+    }
+    removed += next - head.index;
+    if (next < rope.PieceCount()) {
+        spliced.push_back(rope.PieceAt(next));
+        removed++;
+    }
+    Compact(spliced);
+    rope.Splice(at, removed, spliced.data(), spliced.size());
+    return true;
+}
+
+std::vector<Piece> PieceTable::PiecesIn(size_t pos, size_t length) const {
+    std::vector<Piece> pieces;
+    if (pos >= Size() || length == 0) return pieces;
+    size_t end = pos + std::min(length, Size() - pos);
+    Rope::Position start = rope.FindOffset(pos);
+    size_t pieceStart = start.offset;
+    rope.ForEachPiece(start.index, [&](const Piece& piece) {
+        size_t from = pos > pieceStart ? pos - pieceStart : 0;
+        size_t to = std::min(piece.length, end - pieceStart);
+        pieces.push_back(from == 0 && to == piece.length ? piece : Slice(piece, from, to));
+        pieceStart += piece.length;
+        return pieceStart < end;
+    });
+    return pieces;
+}
+
+size_t PieceTable::Read(size_t pos, size_t length, char* out) const {
+    size_t copied = 0;
+    ForEachSpan(pos, length, [&](const char* data, size_t count) {
+        std::copy(data, data + count, out + copied);
+        copied += count;
+        return true;
+    });
+    return copied;
+}
+
+std::string PieceTable::Read(size_t pos, size_t length) const {
+    if (pos >= Size()) return std::string();
+    std::string result(std::min(length, Size() - pos), '\0');
+    Read(pos, result.size(), &result[0]);
+    return result;
+}
+
+char PieceTable::At(size_t pos) const {
+    if (pos >= Size()) return '\0';
+    Rope::Position at = rope.FindOffset(pos);
+    return at.piece.data[pos - at.offset];
+}
+
+void PieceTable::LineColumn(size_t offset, size_t& line, size_t& column) const {
+    offset = std::min(offset, Size());
+    Rope::Position at = rope.FindOffset(offset);
+    line = at.newlines;
+    if (at.index < rope.PieceCount()) line += CountNewlines(at.piece.data, offset - at.offset);
+    column = offset - LineStart(line);
+}
+
+size_t PieceTable::LineStart(size_t line) const {
+    if (line == 0) return 0;
+    line = std::min(line, rope.Newlines());
+    Rope::Position at = rope.FindNewline(line);
+    return at.offset + TextKernels::FindNthNewline(at.piece.data, at.piece.length, line - at.newlines) + 1;
+}
+
+size_t PieceTable::LineEnd(size_t line) const {
+    if (line >= rope.Newlines()) return Size();
+    return LineStart(line + 1) - 1;
+}
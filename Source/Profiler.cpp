@@ -0,0 +1,112 @@
+#include "Profiler.h"
+#include <imgui.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct Scope {
+    const char* name = nullptr;
+    std::atomic<int64_t> frameNanoseconds{ 0 };
+    int64_t history[Profiler::HistoryFrames] = {};
+};
+
+Scope scopes[Profiler::MaxScopes];
+std::atomic<int> scopeCount{ 0 };
+std::mutex registerMutex;
+
+float frameHistory[Profiler::HistoryFrames];
+int historyNext = 0;         // slot the next frame goes into
+int historyFrames = 0;       // frames recorded, up to HistoryFrames
+std::chrono::steady_clock::time_point frameStart;
+bool frameOpen = false;
+
+// Value at fraction p of sorted, which must not be empty.
+template <typename T>
+T Percentile(const std::vector<T>& sorted, double p) {
+    return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+}
+
+}
+
+std::atomic<bool> Profiler::enabled{ false };
+
+int Profiler::Register(const char* name) {
+    std::lock_guard<std::mutex> lock(registerMutex);
+    int count = scopeCount.load();
+    for (int i = 0; i < count; i++)
+        if (strcmp(scopes[i].name, name) == 0) return i;
+    if (count == MaxScopes) return -1;
+    scopes[count].name = name;
+    scopeCount.store(count + 1);
+    return count;
+}
+
+void Profiler::Add(int scope, int64_t nanoseconds) {
+    scopes[scope].frameNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+void Profiler::BeginFrame() {
+    frameOpen = Enabled();
+    if (frameOpen) frameStart = std::chrono::steady_clock::now();
+}
+
+void Profiler::EndFrame() {
+    if (!frameOpen) return;
+    frameOpen = false;
+    frameHistory[historyNext] = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+    int count = scopeCount.load();
+    for (int i = 0; i < count; i++) scopes[i].history[historyNext] = scopes[i].frameNanoseconds.exchange(0);
+    historyNext = (historyNext + 1) % HistoryFrames;
+    historyFrames = std::min(historyFrames + 1, HistoryFrames);
+}
+
+void Profiler::RenderOverlay(bool* open) {
+    ImGui::SetNextWindowBgAlpha(0.85f);
+    ImGui::Begin("Profiler", open, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing);
+    if (historyFrames == 0) {
+        ImGui::TextUnformatted("Collecting frames...");
+        ImGui::End();
+        return;
+    }
+
+    // Oldest first, so the graph scrolls to the left.
+    int first = historyFrames < HistoryFrames ? 0 : historyNext;
+    std::vector<float> frames(historyFrames);
+    for (int i = 0; i < historyFrames; i++) frames[i] = frameHistory[(first + i) % HistoryFrames];
+    std::vector<float> sortedFrames = frames;
+    std::sort(sortedFrames.begin(), sortedFrames.end());
+    char label[96];
+    snprintf(label, sizeof(label), "frame p50 %.2f ms  p99 %.2f ms  max %.2f ms", Percentile(sortedFrames, 0.5),
+        Percentile(sortedFrames, 0.99), sortedFrames.back());
+    ImGui::PlotLines("##frames", frames.data(), historyFrames, 0, label, 0.0f,
+        std::max(sortedFrames.back(), 1000.0f / 60.0f), ImVec2(400, 80));
+
+    if (ImGui::BeginTable("##scopes", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+        ImGui::TableSetupColumn("Scope", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("p50 ms");
+        ImGui::TableSetupColumn("p99 ms");
+        ImGui::TableSetupColumn("max ms");
+        ImGui::TableHeadersRow();
+        std::vector<int64_t> samples(historyFrames);
+        int count = scopeCount.load();
+        for (int i = 0; i < count; i++) {
+            for (int frame = 0; frame < historyFrames; frame++) samples[frame] = scopes[i].history[frame];
+            std::sort(samples.begin(), samples.end());
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(scopes[i].name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", Percentile(samples, 0.5) / 1e6);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", Percentile(samples, 0.99) / 1e6);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", samples.back() / 1e6);
+        }
+        ImGui::EndTable();
+    }
+    ImGui::End();
+}
@@ -0,0 +1,799 @@
+#include "Regex.h"
+#include "TextKernels.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+// Nesting deeper than this is rejected rather than risking the parser's stack.
+constexpr int MaxDepth = 256;
+constexpr int MaxRepeat = 1000;
+// Most bytes read at a time when going backwards.
+constexpr size_t BackwardWindow = 64 * 1024;
+
+bool IsWordByte(int c) { return isalnum(c) || c == '_'; }
+
+// Calls fn(data, length) for the spans of [from, to) from last to first, until it
+// returns false. Read a window at a time, the first small: most scans end within a line.
+template <class Fn>
+void ForEachSpanBackward(const PieceTable& document, size_t from, size_t to, Fn&& fn) {
+    std::vector<std::pair<const char*, size_t>> spans;
+    size_t window = 1024;
+    for (size_t windowEnd = to; windowEnd > from; window = std::min(window * 4, BackwardWindow)) {
+        size_t windowStart = windowEnd - std::min(windowEnd - from, window);
+        spans.clear();
+        document.ForEachSpan(windowStart, windowEnd - windowStart, [&](const char* data, size_t length) {
+            spans.emplace_back(data, length);
+            return true;
+        });
+        for (size_t i = spans.size(); i-- > 0;)
+            if (!fn(spans[i].first, spans[i].second)) return;
+        windowEnd = windowStart;
+    }
+}
+
+}
+
+struct Regex::Node {
+    enum Type { Empty, Bytes, Concat, Alternate, Repeat, LineStart, LineEnd } type = Empty;
+    std::bitset<256> bytes;
+    std::vector<Node> children;
+    int min = 0;
+    int max = -1;   // -1: unbounded
+};
+
+// Outs are the dangling exits of a partly built NFA, as state * 2 + which branch.
+struct Regex::Fragment {
+    int start;
+    std::vector<int> outs;
+};
+
+// Recursive descent over the syntax in Regex.h, producing a Node tree.
+class Regex::Parser {
+public:
+    Parser(const std::string& pattern, bool ignoreCase) : text(pattern), pos(0), depth(0), ignoreCase(ignoreCase) {}
+
+    bool Parse(Node& out, std::string& error) {
+        bool ok = Alternation(out);
+        if (ok && pos < text.size()) ok = Fail(text[pos] == ')' ? "Unmatched )" : "Unexpected character");
+        error = message;
+        return ok;
+    }
+
+private:
+    bool Fail(const char* reason) {
+        if (message.empty()) {
+            char buffer[96];
+            snprintf(buffer, sizeof(buffer), "%s at position %zu", reason, pos + 1);
+            message = buffer;
+        }
+        return false;
+    }
+
+    bool More() const { return pos < text.size(); }
+    unsigned char Peek() const { return (unsigned char)text[pos]; }
+
+    // A byte, and its other case when ignoring case.
+    std::bitset<256> Literal(unsigned char c) const {
+        std::bitset<256> bytes;
+        bytes.set(c);
+        if (ignoreCase && isalpha(c)) bytes.set(isupper(c) ? tolower(c) : toupper(c));
+        return bytes;
+    }
+
+    bool Alternation(Node& out) {
+        if (++depth > MaxDepth) return Fail("Pattern nested too deeply");
+        Node first;
+        if (!Sequence(first)) return false;
+        if (More() && Peek() == '|') {
+            out.type = Node::Alternate;
+            out.children.push_back(std::move(first));
+            while (More() && Peek() == '|') {
+                pos++;
+                Node next;
+                if (!Sequence(next)) return false;
+                out.children.push_back(std::move(next));
+            }
+        }
+        else {
+            out = std::move(first);
+        }
+        depth--;
+        return true;
+    }
+
+    bool Sequence(Node& out) {
+        out.type = Node::Concat;
+        while (More() && Peek() != '|' && Peek() != ')') {
+            Node atom;
+            if (!Atom(atom) || !Quantifiers(atom)) return false;
+            // Flattened, so a leading literal prefix is easy to see.
+            if (atom.type == Node::Concat) {
+                for (Node& child : atom.children) out.children.push_back(std::move(child));
+            }
+            else {
+                out.children.push_back(std::move(atom));
+            }
+        }
+        if (out.children.size() == 1) {
+            Node only = std::move(out.children[0]);
+            out = std::move(only);
+        }
+        else if (out.children.empty()) {
+            out.type = Node::Empty;
+        }
+        return true;
+    }
+
+    bool Atom(Node& out) {
+        unsigned char c = Peek();
+        pos++;
+        switch (c) {
+        case '(':
+            if (text.compare(pos, 2, "?:") == 0) pos += 2;
+            else if (More() && Peek() == '?') return Fail("Unsupported group");
+            if (!Alternation(out)) return false;
+            if (!More() || Peek() != ')') return Fail("Missing )");
+            pos++;
+            return true;
+        case '[':
+            out.type = Node::Bytes;
+            if (!Class(out.bytes)) return false;
+            break;
+        case '.':
+            out.type = Node::Bytes;
+            out.bytes.set();
+            break;
+        case '^':
+            out.type = Node::LineStart;
+            return true;
+        case '$':
+            out.type = Node::LineEnd;
+            return true;
+        case '\\':
+            out.type = Node::Bytes;
+            if (!Escape(out.bytes)) return false;
+            break;
+        case '*': case '+': case '?':
+            pos--;
+            return Fail("Nothing to repeat");
+        default:
+            out.type = Node::Bytes;
+            out.bytes = Literal(c);
+            break;
+        }
+        // Matches never span lines, so no set holds a line break.
+        out.bytes.reset('\n');
+        return true;
+    }
+
+    // Any number of quantifiers after an atom; each wraps what came before.
+    bool Quantifiers(Node& atom) {
+        while (More()) {
+            int min, max;
+            unsigned char c = Peek();
+            if (c == '*') { min = 0; max = -1; pos++; }
+            else if (c == '+') { min = 1; max = -1; pos++; }
+            else if (c == '?') { min = 0; max = 1; pos++; }
+            else if (c != '{' || !Counted(min, max)) return message.empty();
+            if (atom.type == Node::LineStart || atom.type == Node::LineEnd) return Fail("Nothing to repeat");
+            if (More() && Peek() == '?') pos++;
+            Node repeat;
+            repeat.type = Node::Repeat;
+            repeat.min = min;
+            repeat.max = max;
+            repeat.children.push_back(std::move(atom));
+            atom = std::move(repeat);
+        }
+        return true;
+    }
+
+    // {n}, {n,} or {n,m}. Anything else leaves the brace to be read as a literal; bad
+    // counts fail.
+    bool Counted(int& min, int& max) {
+        size_t i = pos + 1;
+        auto number = [&](int& value) {
+            size_t begin = i;
+            value = 0;
+            while (i < text.size() && isdigit((unsigned char)text[i])) value = std::min(value * 10 + (text[i++] - '0'), MaxRepeat + 1);
+            return i > begin;
+        };
+        if (!number(min)) return false;
+        max = min;
+        if (i < text.size() && text[i] == ',') {
+            i++;
+            if (!number(max)) max = -1;
+        }
+        if (i >= text.size() || text[i] != '}') return false;
+        pos = i + 1;
+        if (min > MaxRepeat || max > MaxRepeat || (max >= 0 && max < min)) return Fail("Bad repeat count");
+        return true;
+    }
+
+    bool Class(std::bitset<256>& out) {
+        bool negate = More() && Peek() == '^';
+        if (negate) pos++;
+        bool first = true;
+        while (More() && (Peek() != ']' || first)) {
+            first = false;
+            std::bitset<256> item;
+            int low = -1;
+            if (Peek() == '\\') {
+                pos++;
+                if (!Escape(item)) return false;
+                if (item.count() == 1) for (low = 0; !item[low]; low++) {}
+            }
+            else {
+                low = Peek();
+                pos++;
+            }
+            if (low >= 0 && pos + 1 < text.size() && Peek() == '-' && text[pos + 1] != ']') {
+                pos++;
+                int high;
+                if (Peek() == '\\') {
+                    pos++;
+                    std::bitset<256> end;
+                    if (!Escape(end) || end.count() != 1) return Fail("Bad range");
+                    for (high = 0; !end[high]; high++) {}
+                }
+                else {
+                    high = Peek();
+                    pos++;
+                }
+                if (high < low) return Fail("Bad range");
+                for (int c = low; c <= high; c++) item |= Literal((unsigned char)c);
+            }
+            else if (low >= 0) {
+                item |= Literal((unsigned char)low);
+            }
+            out |= item;
+        }
+        if (!More()) return Fail("Missing ]");
+        pos++;
+        if (negate) out.flip();
+        return true;
+    }
+
+    // The escape after a backslash, as the set of bytes it matches.
+    bool Escape(std::bitset<256>& out) {
+        if (!More()) return Fail("Trailing backslash");
+        unsigned char c = Peek();
+        pos++;
+        switch (c) {
+        case 'd': case 'D': case 'w': case 'W': case 's': case 'S': {
+            std::bitset<256> bytes;
+            for (int b = 0; b < 256; b++) {
+                if (c == 'd' || c == 'D') bytes[b] = isdigit(b) != 0;
+                else if (c == 'w' || c == 'W') bytes[b] = IsWordByte(b);
+                else bytes[b] = b == ' ' || (b >= '\t' && b <= '\r');
+            }
+            if (isupper(c)) bytes.flip();
+            out = bytes;
+            return true;
+        }
+        case 't': out = Literal('\t'); return true;
+        case 'n': out = Literal('\n'); return true;
+        case 'r': out = Literal('\r'); return true;
+        case 'f': out = Literal('\f'); return true;
+        case 'v': out = Literal('\v'); return true;
+        case 'x': {
+            if (pos + 2 > text.size() || !isxdigit((unsigned char)text[pos]) || !isxdigit((unsigned char)text[pos + 1]))
+                return Fail("Bad \\x escape");
+            out = Literal((unsigned char)std::stoi(text.substr(pos, 2), nullptr, 16));
+            pos += 2;
+            return true;
+        }
+        default:
+            if (isalnum(c)) {
+                pos--;
+                return Fail("Unsupported escape");
+            }
+            out = Literal(c);
+            return true;
+        }
+    }
+
+    const std::string& text;
+    size_t pos;
+    int depth;
+    bool ignoreCase;
+    std::string message;
+};
+
+bool Regex::Compile(const std::string& source, std::string& error) {
+    pattern = source;
+    prefix.clear();
+    states.clear();
+    ClearCache();
+    statesBuilt = cacheClears = nfaFallbacks = 0;
+
+    bool ignoreCase = source.compare(0, 4, "(?i)") == 0;
+    std::string body = source.substr(ignoreCase ? 4 : 0);
+    Parser parser(body, ignoreCase);
+    Node root;
+    if (!parser.Parse(root, error)) return false;
+
+    // The pattern forwards, then backwards to find where matches start.
+    int match = AddState(Kind::Match);
+    Fragment fragment = CompileNode(root, false);
+    Patch(fragment, match);
+    start = fragment.start;
+    match = AddState(Kind::Match);
+    fragment = CompileNode(root, true);
+    Patch(fragment, match);
+    reverseStart = fragment.start;
+    if (states.size() > 2 * MaxStates) {
+        states.clear();
+        error = "Pattern too large";
+        return false;
+    }
+
+    // Literal bytes every match starts with: a leading ^ is skipped, a single-byte set
+    // is taken, and a repeat of one counts once if it must occur.
+    const std::vector<Node> single(1, root);
+    const std::vector<Node>& items = root.type == Node::Concat ? root.children : single;
+    for (const Node& item : items) {
+        if (item.type == Node::LineStart && prefix.empty()) continue;
+        const Node* node = &item;
+        bool last = false;
+        if (node->type == Node::Repeat && node->min >= 1) {
+            last = node->max != 1;
+            node = &node->children[0];
+        }
+        if (node->type != Node::Bytes || node->bytes.count() != 1) break;
+        int byte = 0;
+        while (!node->bytes[byte]) byte++;
+        prefix += (char)byte;
+        if (last) break;
+    }
+
+    BuildByteClasses();
+    marks.assign(states.size(), 0);
+    markGeneration = 0;
+    ClearCache();
+    return true;
+}
+
+int Regex::AddState(Kind kind, int out, int out1) {
+    states.push_back(State{ kind, out, out1, std::bitset<256>() });
+    return (int)states.size() - 1;
+}
+
+void Regex::Patch(const Fragment& fragment, int target) {
+    for (int out : fragment.outs) (out & 1 ? states[out >> 1].out1 : states[out >> 1].out) = target;
+}
+
+Regex::Fragment Regex::CompileNode(const Node& node, bool reverse) {
+    // Past the limit, stop building; Compile() rejects the pattern.
+    if (states.size() > 2 * MaxStates) {
+        int s = AddState(Kind::Empty);
+        return Fragment{ s, { s * 2 } };
+    }
+    switch (node.type) {
+    case Node::Bytes: {
+        int s = AddState(Kind::Byte);
+        states[s].bytes = node.bytes;
+        return Fragment{ s, { s * 2 } };
+    }
+    case Node::LineStart:
+    case Node::LineEnd: {
+        // Read backwards, the start of a line is where a line end would be.
+        int s = AddState((node.type == Node::LineStart) != reverse ? Kind::LineStart : Kind::LineEnd);
+        return Fragment{ s, { s * 2 } };
+    }
+    case Node::Concat: {
+        size_t count = node.children.size();
+        Fragment result = CompileNode(node.children[reverse ? count - 1 : 0], reverse);
+        for (size_t i = 1; i < count; i++) {
+            Fragment next = CompileNode(node.children[reverse ? count - 1 - i : i], reverse);
+            Patch(result, next.start);
+            result.outs = std::move(next.outs);
+        }
+        return result;
+    }
+    case Node::Alternate: {
+        Fragment result = CompileNode(node.children[0], reverse);
+        for (size_t i = 1; i < node.children.size(); i++) {
+            Fragment next = CompileNode(node.children[i], reverse);
+            int split = AddState(Kind::Split, result.start, next.start);
+            result.start = split;
+            result.outs.insert(result.outs.end(), next.outs.begin(), next.outs.end());
+        }
+        return result;
+    }
+    case Node::Repeat: {
+        const Node& child = node.children[0];
+        // min copies in a row, then either a loop or max - min optional copies.
+        int entry = AddState(Kind::Empty);
+        Fragment result{ entry, { entry * 2 } };
+        for (int i = 0; i < node.min; i++) {
+            Fragment copy = CompileNode(child, reverse);
+            Patch(result, copy.start);
+            result.outs = std::move(copy.outs);
+        }
+        if (node.max < 0) {
+            Fragment body = CompileNode(child, reverse);
+            int loop = AddState(Kind::Split, body.start);
+            Patch(result, loop);
+            Patch(body, loop);
+            result.outs.assign(1, loop * 2 + 1);
+        }
+        else {
+            std::vector<int> skips;
+            for (int i = node.min; i < node.max; i++) {
+                Fragment copy = CompileNode(child, reverse);
+                int optional = AddState(Kind::Split, copy.start);
+                Patch(result, optional);
+                skips.push_back(optional * 2 + 1);
+                result.outs = std::move(copy.outs);
+            }
+            result.outs.insert(result.outs.end(), skips.begin(), skips.end());
+        }
+        return result;
+    }
+    default: {
+        int s = AddState(Kind::Empty);
+        return Fragment{ s, { s * 2 } };
+    }
+    }
+}
+
+void Regex::BuildByteClasses() {
+    // A new class starts wherever some state's set changes, and around '\n', which decides
+    // where $ matches.
+    std::bitset<256> boundaries;
+    boundaries.set(0);
+    boundaries.set('\n');
+    boundaries.set('\n' + 1);
+    for (const State& state : states) {
+        if (state.kind != Kind::Byte) continue;
+        for (int b = 1; b < 256; b++)
+            if (state.bytes[b] != state.bytes[b - 1]) boundaries.set(b);
+    }
+    classCount = 0;
+    for (int b = 0; b < 256; b++) {
+        if (boundaries[b]) classByte[classCount++] = (uint8_t)b;
+        classOf[b] = (uint8_t)(classCount - 1);
+    }
+}
+
+void Regex::Closure(const std::vector<int>& from, bool lineStart, bool lineEnd, std::vector<int>& out) {
+    out.clear();
+    if (++markGeneration == 0) {
+        std::fill(marks.begin(), marks.end(), 0);
+        markGeneration = 1;
+    }
+    stack.assign(from.rbegin(), from.rend());
+    while (!stack.empty()) {
+        int id = stack.back();
+        stack.pop_back();
+        if (marks[id] == markGeneration) continue;
+        marks[id] = markGeneration;
+        const State& state = states[id];
+        switch (state.kind) {
+        case Kind::Byte:
+        case Kind::Match: out.push_back(id); break;
+        case Kind::Split: stack.push_back(state.out1); stack.push_back(state.out); break;
+        case Kind::Empty: stack.push_back(state.out); break;
+        case Kind::LineStart: if (lineStart) stack.push_back(state.out); break;
+        case Kind::LineEnd: if (lineEnd) stack.push_back(state.out); break;
+        }
+    }
+}
+
+void Regex::ClearCache() {
+    dstates.clear();
+    transitions.clear();
+    dindex.clear();
+    cacheBytes = 0;
+    dead = -1;
+    for (int lineStart = 0; lineStart < 2; lineStart++)
+        startStates[lineStart] = anchoredStarts[lineStart] = reverseStarts[lineStart] = -1;
+    if (states.empty()) return;
+    std::vector<int> initial(1, start);
+    std::vector<int> reverseInitial(1, reverseStart);
+    for (int lineStart = 0; lineStart < 2; lineStart++) {
+        startStates[lineStart] = AddDState(initial, lineStart != 0, false);
+        anchoredStarts[lineStart] = AddDState(initial, lineStart != 0, true);
+        reverseStarts[lineStart] = AddDState(reverseInitial, lineStart != 0, true);
+    }
+}
+
+int Regex::AddDState(const std::vector<int>& nfaStates, bool lineStart, bool anchored) {
+    // Once nothing can match, the context doesn't matter: there is one dead state.
+    if (nfaStates.empty()) {
+        lineStart = false;
+        anchored = true;
+    }
+    std::string key((const char*)nfaStates.data(), nfaStates.size() * sizeof(int));
+    key += (char)((lineStart ? 1 : 0) | (anchored ? 2 : 0));
+    auto found = dindex.find(key);
+    if (found != dindex.end()) return found->second;
+    // Roughly what the state costs: its kernel twice (here and as the key), its row of
+    // transitions, and the bookkeeping around them.
+    size_t cost = key.size() * 2 + classCount * sizeof(int) + 64;
+    if (cacheBytes + cost > MaxCacheBytes && !dstates.empty()) return -1;
+    cacheBytes += cost;
+    statesBuilt++;
+    int index = (int)dstates.size();
+    if (nfaStates.empty()) dead = index;
+    dstates.push_back(DState{ nfaStates, lineStart, anchored });
+    transitions.resize(transitions.size() + classCount, -1);
+    dindex.emplace(std::move(key), index);
+    return index;
+}
+
+int Regex::Transition(int s, int cls) {
+    unsigned char b = classByte[cls];
+    bool anchored = dstates[s].anchored;
+    Closure(dstates[s].kernel, dstates[s].lineStart, b == '\n', closure);
+    bool match = false;
+    kernel.clear();
+    for (int id : closure) {
+        if (states[id].kind == Kind::Match) match = true;
+        else if (states[id].bytes[b]) kernel.push_back(states[id].out);
+    }
+    // Unanchored: a match may start after any byte.
+    if (!anchored) kernel.push_back(start);
+    std::sort(kernel.begin(), kernel.end());
+    kernel.erase(std::unique(kernel.begin(), kernel.end()), kernel.end());
+    int next = AddDState(kernel, b == '\n', anchored);
+    if (next < 0) return -1;
+    int encoded = (next * classCount) * 2 + (match ? 1 : 0);
+    transitions[(size_t)s * classCount + cls] = encoded;
+    return encoded;
+}
+
+bool Regex::MatchesAtEnd(int s, bool lineEnd) {
+    Closure(dstates[s].kernel, dstates[s].lineStart, lineEnd, closure);
+    for (int id : closure)
+        if (states[id].kind == Kind::Match) return true;
+    return false;
+}
+
+bool Regex::Find(const PieceTable& document, size_t from, size_t to, size_t& matchStart, size_t& matchEnd) {
+    to = std::min(to, document.Size());
+    if (states.empty() || from > to) return false;
+    bool lineStart = from == 0 || document.At(from - 1) == '\n';
+    bool lineEndAtTo = to == document.Size() || document.At(to) == '\n';
+
+    // Forward over the text to where the first match ends. The DFA doesn't track where
+    // matches start, but they can't span lines, so the leftmost one starts on that line.
+    const int* table = transitions.data();
+    int s = startStates[lineStart];
+    size_t end = SIZE_MAX;
+    size_t fallback = SIZE_MAX;
+    size_t spanStart = from;
+    size_t clears = 0, clearedAt = from;
+    document.ForEachSpan(from, to - from, [&](const char* data, size_t length) {
+        if (Cancelled()) return false;
+        // Locals, so the compiler can keep them in registers: stores through s could
+        // otherwise alias the members. Rows are kept as offsets into the table, which
+        // keeps a multiply out of the loop.
+        const uint8_t* classes = classOf;
+        const int width = classCount;
+        int starts[2] = { startStates[0] * width, startStates[1] * width };
+        const bool skipToPrefix = !prefix.empty();
+        int row = s * width;
+        size_t i = 0;
+        while (i < length) {
+            if (skipToPrefix && (row == starts[0] || row == starts[1])) {
+                // Nothing in progress: skip to the next place a match could start. Near the
+                // end of the span a prefix may run into the next one, so those bytes are
+                // stepped through instead.
+                size_t found = i + TextKernels::FindSubstring(data + i, length - i, prefix.data(), prefix.size());
+                size_t skip = found < length ? found : std::max(i, length - std::min(length, prefix.size() - 1));
+                if (skip > i) {
+                    row = starts[data[skip - 1] == '\n'];
+                    i = skip;
+                    if (i == length) break;
+                }
+            }
+            unsigned char b = (unsigned char)data[i];
+            int t = table[(size_t)row + classes[b]];
+            if (t < 0) {
+                t = Transition(row / width, classes[b]);
+                if (t < 0) {
+                    size_t pos = spanStart + i;
+                    if (++clears > MaxClears && pos - clearedAt < ThrashBytesPerState * dstates.size()) {
+                        fallback = pos;
+                        s = row / width;
+                        return false;
+                    }
+                    clearedAt = pos;
+                    DState current = dstates[row / width];
+                    ClearCache();
+                    cacheClears++;
+                    starts[0] = startStates[0] * width;
+                    starts[1] = startStates[1] * width;
+                    int state = AddDState(current.kernel, current.lineStart, false);
+                    t = Transition(state, classes[b]);
+                }
+                table = transitions.data();
+            }
+            if (t & 1) {
+                end = spanStart + i;
+                s = row / width;
+                return false;
+            }
+            row = t >> 1;
+            i++;
+        }
+        s = row / width;
+        spanStart += length;
+        return true;
+    });
+    if (Cancelled()) return false;
+    if (end == SIZE_MAX && fallback == SIZE_MAX) {
+        if (!MatchesAtEnd(s, lineEndAtTo)) return false;
+        end = to;
+    }
+
+    // Back to the start of the line, or from.
+    size_t pos = end != SIZE_MAX ? end : fallback;
+    size_t begin = from;
+    ForEachSpanBackward(document, from, pos, [&](const char* data, size_t length) {
+        for (size_t i = length; i-- > 0;) {
+            pos--;
+            if (data[i] == '\n') {
+                begin = pos + 1;
+                return false;
+            }
+        }
+        return true;
+    });
+    bool lineStartAtBegin = begin > from || lineStart;
+    if (fallback == SIZE_MAX && Bounds(document, begin, lineStartAtBegin, end, to, lineEndAtTo, matchStart, matchEnd))
+        return true;
+    nfaFallbacks++;
+    return SimulateNfa(document, begin, to, lineEndAtTo, matchStart, matchEnd);
+}
+
+bool Regex::Bounds(const PieceTable& document, size_t begin, bool lineStartAtBegin, size_t end, size_t to,
+    bool lineEndAtTo, size_t& matchStart, size_t& matchEnd) {
+    // Backwards from end to the leftmost start of a match ending there. Either runs into
+    // a line break, if not sooner, where the DFA dies.
+    int s = reverseStarts[end == to ? lineEndAtTo : document.At(end) == '\n'];
+    size_t first = SIZE_MAX;
+    if (!Run(document, s, begin, end, true, first)) return false;
+    if (s != dead && MatchesAtEnd(s, lineStartAtBegin)) first = begin;
+    if (first == SIZE_MAX) return false;
+
+    // A match starting further left would end after end. Look for one by running the
+    // unanchored DFA up to first, then on without starting new matches.
+    if (first > begin) {
+        s = startStates[lineStartAtBegin];
+        size_t earlier = SIZE_MAX;
+        if (!Run(document, s, begin, first - 1, false, earlier)) return false;
+        DState current = dstates[s];
+        s = AddDState(current.kernel, current.lineStart, true);
+        if (s < 0 || !Run(document, s, first - 1, to, false, earlier)) return false;
+        if (earlier != SIZE_MAX || (s != dead && MatchesAtEnd(s, lineEndAtTo))) return false;
+    }
+
+    // Forwards from first to the longest match. begin is where the line starts, if it
+    // does here, so first can only be at a line start if it is begin.
+    s = anchoredStarts[first == begin && lineStartAtBegin];
+    size_t last = SIZE_MAX;
+    if (!Run(document, s, first, to, false, last)) return false;
+    if (s != dead && MatchesAtEnd(s, lineEndAtTo)) last = to;
+    if (last == SIZE_MAX) return false;
+    matchStart = first;
+    matchEnd = last;
+    return true;
+}
+
+bool Regex::Run(const PieceTable& document, int& s, size_t from, size_t to, bool backward, size_t& last) {
+    int row = s * classCount;
+    bool full = false;
+    // Steps over the byte at pos; false once the state is dead or the cache is full.
+    auto step = [&](unsigned char b, size_t pos) {
+        int t = transitions[(size_t)row + classOf[b]];
+        if (t < 0) {
+            t = Transition(row / classCount, classOf[b]);
+            if (t < 0) {
+                full = true;
+                return false;
+            }
+        }
+        // Backwards, the match found before the byte ends (that is, starts) after it.
+        if (t & 1) last = backward ? pos + 1 : pos;
+        row = t >> 1;
+        return row != dead * classCount;
+    };
+
+    if (!backward) {
+        size_t pos = from;
+        document.ForEachSpan(from, to - from, [&](const char* data, size_t length) {
+            for (size_t i = 0; i < length; i++, pos++)
+                if (!step((unsigned char)data[i], pos)) return false;
+            return true;
+        });
+    }
+    else {
+        size_t pos = to;
+        ForEachSpanBackward(document, from, to, [&](const char* data, size_t length) {
+            for (size_t i = length; i-- > 0;)
+                if (!step((unsigned char)data[i], --pos)) return false;
+            return true;
+        });
+    }
+    s = row / classCount;
+    return !full;
+}
+
+// Pike's VM: threads are NFA states tagged with where their match started, kept in order
+// of that start so the leftmost one claims a state first. New threads stop once a match
+// is found, and the search ends when no thread could still start at or before it.
+bool Regex::SimulateNfa(const PieceTable& document, size_t begin, size_t limit, bool lineEndAtLimit,
+    size_t& matchStart, size_t& matchEnd) {
+    struct Thread {
+        int state;
+        size_t start;
+    };
+    std::vector<Thread> current, expanded;
+    bool found = false;
+
+    // Expands the threads at pos, records matches, and advances them over byte b (or
+    // not at all when b is -1).
+    auto step = [&](size_t pos, int b, bool lineStart, bool lineEnd) {
+        if (!found) current.push_back(Thread{ start, pos });
+        if (++markGeneration == 0) {
+            std::fill(marks.begin(), marks.end(), 0);
+            markGeneration = 1;
+        }
+        expanded.clear();
+        for (const Thread& thread : current) {
+            if (found && thread.start > matchStart) break;
+            stack.assign(1, thread.state);
+            while (!stack.empty()) {
+                int id = stack.back();
+                stack.pop_back();
+                if (marks[id] == markGeneration) continue;
+                marks[id] = markGeneration;
+                const State& state = states[id];
+                switch (state.kind) {
+                case Kind::Byte: expanded.push_back(Thread{ id, thread.start }); break;
+                case Kind::Match:
+                    if (!found || thread.start < matchStart || (thread.start == matchStart && pos > matchEnd)) {
+                        found = true;
+                        matchStart = thread.start;
+                        matchEnd = pos;
+                    }
+                    break;
+                case Kind::Split: stack.push_back(state.out1); stack.push_back(state.out); break;
+                case Kind::Empty: stack.push_back(state.out); break;
+                case Kind::LineStart: if (lineStart) stack.push_back(state.out); break;
+                case Kind::LineEnd: if (lineEnd) stack.push_back(state.out); break;
+                }
+            }
+        }
+        current.clear();
+        if (b < 0) return;
+        for (const Thread& thread : expanded)
+            if (states[thread.state].bytes[b]) current.push_back(Thread{ states[thread.state].out, thread.start });
+    };
+
+    bool lineStart = begin == 0 || document.At(begin - 1) == '\n';
+    size_t pos = begin;
+    bool done = false;
+    document.ForEachSpan(begin, limit - begin, [&](const char* data, size_t length) {
+        if (Cancelled()) return false;
+        for (size_t i = 0; i < length; i++, pos++) {
+            unsigned char b = (unsigned char)data[i];
+            step(pos, b, lineStart, b == '\n');
+            if (found && current.empty()) {
+                done = true;
+                return false;
+            }
+            lineStart = b == '\n';
+        }
+        return true;
+    });
+    if (Cancelled()) return false;
+    if (!done) step(limit, -1, lineStart, lineEndAtLimit);
+    return found;
+}
@@ -0,0 +1,211 @@
+#include "Rope.h"
+#include <algorithm>
+
+Rope::NodePtr Rope::MakeLeaf(std::vector<Piece> items) {
+    auto node = std::make_shared<Node>();
+    node->leaf = true;
+    for (const Piece& piece : items) {
+        node->bytes += piece.length;
+        node->newlines += piece.newlines;
+    }
+    node->pieces = items.size();
+    node->items = std::move(items);
+    return node;
+}
+
+Rope::NodePtr Rope::MakeInternal(NodeList children) {
+    auto node = std::make_shared<Node>();
+    node->leaf = false;
+    for (const NodePtr& child : children) {
+        node->bytes += child->bytes;
+        node->newlines += child->newlines;
+        node->pieces += child->pieces;
+    }
+    node->children = std::move(children);
+    return node;
+}
+
+// Both splitters spread the entries evenly over the fewest nodes that respect MaxEntries.
+Rope::NodeList Rope::SplitLeaves(std::vector<Piece> items) {
+    NodeList out;
+    if (items.empty()) return out;
+    size_t groups = (items.size() + MaxEntries - 1) / MaxEntries;
+    size_t begin = 0;
+    for (size_t g = 0; g < groups; g++) {
+        size_t end = items.size() * (g + 1) / groups;
+        out.push_back(MakeLeaf(std::vector<Piece>(items.begin() + begin, items.begin() + end)));
+        begin = end;
+    }
+    return out;
+}
+
+Rope::NodeList Rope::SplitInternal(NodeList children) {
+    NodeList out;
+    if (children.empty()) return out;
+    size_t groups = (children.size() + MaxEntries - 1) / MaxEntries;
+    size_t begin = 0;
+    for (size_t g = 0; g < groups; g++) {
+        size_t end = children.size() * (g + 1) / groups;
+        out.push_back(MakeInternal(NodeList(children.begin() + begin, children.begin() + end)));
+        begin = end;
+    }
+    return out;
+}
+
+void Rope::Rebalance(NodeList& nodes, size_t from, size_t to) {
+    // Merge underfull nodes produced by a splice with a neighbour, then re-split.
+    size_t i = from > 0 ? from - 1 : 0;
+    to = std::min(to + 1, nodes.size());
+    while (i < to && nodes.size() > 1) {
+        if (nodes[i]->Entries() >= MinEntries) { i++; continue; }
+        size_t left = i + 1 < nodes.size() ? i : i - 1;
+        const Node& a = *nodes[left];
+        const Node& b = *nodes[left + 1];
+        NodeList merged;
+        if (a.leaf) {
+            std::vector<Piece> items(a.items);
+            items.insert(items.end(), b.items.begin(), b.items.end());
+            merged = SplitLeaves(std::move(items));
+        }
+        else {
+            NodeList children(a.children);
+            children.insert(children.end(), b.children.begin(), b.children.end());
+            merged = SplitInternal(std::move(children));
+        }
+        nodes.erase(nodes.begin() + left, nodes.begin() + left + 2);
+        nodes.insert(nodes.begin() + left, merged.begin(), merged.end());
+        to = std::min(to, nodes.size());
+        i = left;
+    }
+}
+
+Rope::NodeList Rope::SpliceNode(const NodePtr& node, size_t index, size_t removeCount, const Piece* pieces, size_t count) {
+    if (node->leaf) {
+        std::vector<Piece> items;
+        items.reserve(node->items.size() - removeCount + count);
+        items.insert(items.end(), node->items.begin(), node->items.begin() + index);
+        items.insert(items.end(), pieces, pieces + count);
+        items.insert(items.end(), node->items.begin() + index + removeCount, node->items.end());
+        return SplitLeaves(std::move(items));
+    }
+
+    const NodeList& children = node->children;
+    size_t c = 0, base = 0;
+    while (c + 1 < children.size()) {
+        size_t end = base + children[c]->pieces;
+        if (index < end || (index == end && removeCount == 0)) break;
+        base = end;
+        c++;
+    }
+
+    NodeList result(children.begin(), children.begin() + c);
+    size_t fixFrom = result.size();
+
+    size_t local = index - base;
+    size_t take = std::min(removeCount, children[c]->pieces - local);
+    NodeList first = SpliceNode(children[c], local, take, pieces, count);
+    result.insert(result.end(), first.begin(), first.end());
+
+    // Children entirely inside the removed range are dropped without being visited.
+    size_t remaining = removeCount - take;
+    size_t next = c + 1;
+    while (remaining > 0 && next < children.size() && remaining >= children[next]->pieces) {
+        remaining -= children[next]->pieces;
+        next++;
+    }
+    if (remaining > 0 && next < children.size()) {
+        NodeList last = SpliceNode(children[next], 0, remaining, nullptr, 0);
+        result.insert(result.end(), last.begin(), last.end());
+        next++;
+    }
+    size_t fixTo = result.size();
+    result.insert(result.end(), children.begin() + next, children.end());
+
+    Rebalance(result, fixFrom, fixTo);
+    return SplitInternal(std::move(result));
+}
+
+Rope::NodePtr Rope::BuildUp(NodeList level) {
+    while (level.size() > 1) level = SplitInternal(std::move(level));
+    NodePtr top = level.empty() ? nullptr : level[0];
+    while (top && !top->leaf && top->children.size() == 1) top = top->children[0];
+    return top;
+}
+
+void Rope::Assign(const std::vector<Piece>& pieces) {
+    root = BuildUp(SplitLeaves(pieces));
+}
+
+void Rope::Splice(size_t index, size_t removeCount, const Piece* pieces, size_t count) {
+    if (!root) {
+        root = BuildUp(SplitLeaves(std::vector<Piece>(pieces, pieces + count)));
+        return;
+    }
+    index = std::min(index, root->pieces);
+    removeCount = std::min(removeCount, root->pieces - index);
+    if (removeCount == 0 && count == 0) return;
+    root = BuildUp(SpliceNode(root, index, removeCount, pieces, count));
+}
+
+Piece Rope::PieceAt(size_t index) const {
+    const Node* node = root.get();
+    while (!node->leaf) {
+        for (const NodePtr& child : node->children) {
+            if (index < child->pieces) { node = child.get(); break; }
+            index -= child->pieces;
+        }
+    }
+    return node->items[index];
+}
+
+Rope::Position Rope::FindOffset(size_t offset) const {
+    Position pos{ 0, 0, 0, Piece{} };
+    if (!root || offset >= root->bytes) {
+        pos.index = PieceCount();
+        pos.offset = Size();
+        pos.newlines = Newlines();
+        return pos;
+    }
+    const Node* node = root.get();
+    while (!node->leaf) {
+        for (const NodePtr& child : node->children) {
+            if (offset < pos.offset + child->bytes) { node = child.get(); break; }
+            pos.index += child->pieces;
+            pos.offset += child->bytes;
+            pos.newlines += child->newlines;
+        }
+    }
+    for (const Piece& piece : node->items) {
+        if (offset < pos.offset + piece.length) { pos.piece = piece; break; }
+        pos.index++;
+        pos.offset += piece.length;
+        pos.newlines += piece.newlines;
+    }
+    return pos;
+}
+
+Rope::Position Rope::FindNewline(size_t n) const {
+    Position pos{ 0, 0, 0, Piece{} };
+    if (!root || n == 0 || n > root->newlines) {
+        pos.index = PieceCount();
+        pos.offset = Size();
+        pos.newlines = Newlines();
+        return pos;
+    }
+    const Node* node = root.get();
+    while (!node->leaf) {
+        for (const NodePtr& child : node->children) {
+            if (n <= pos.newlines + child->newlines) { node = child.get(); break; }
+            pos.index += child->pieces;
+            pos.offset += child->bytes;
+            pos.newlines += child->newlines;
+        }
+    }
+    for (const Piece& piece : node->items) {
+        if (n <= pos.newlines + piece.newlines) { pos.piece = piece; break; }
+        pos.index++;
+        pos.offset += piece.length;
+        pos.newlines += piece.newlines;
+    }
+    return pos;
+}
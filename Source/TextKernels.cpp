@@ -0,0 +1,489 @@
+#include "TextKernels.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TEXT_KERNELS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TEXT_KERNELS_TARGET(isa) __attribute__((target(isa)))
+#else
+#define TEXT_KERNELS_TARGET(isa)
+#endif
+
+namespace TextKernels {
+namespace {
+
+struct Kernels {
+    size_t (*countNewlines)(const char*, size_t);
+    size_t (*countWordStarts)(const char*, size_t, bool&);
+    size_t (*findNthNewline)(const char*, size_t, size_t);
+    size_t (*findSubstring)(const char*, size_t, const char*, size_t);
+};
+
+inline bool IsSpace(unsigned char c) { return c == ' ' || (unsigned char)(c - 9) <= 4; }
+
+size_t CountNewlinesScalar(const char* data, size_t length) {
+    size_t count = 0;
+    for (size_t i = 0; i < length; i++) count += data[i] == '\n';
+    return count;
+}
+
+size_t CountWordStartsScalar(const char* data, size_t length, bool& inWord) {
+    size_t count = 0;
+    for (size_t i = 0; i < length; i++) {
+        bool space = IsSpace((unsigned char)data[i]);
+        count += !space && !inWord;
+        inWord = !space;
+    }
+    return count;
+}
+
+size_t FindNthNewlineScalar(const char* data, size_t length, size_t n) {
+    for (size_t i = 0; i < length; i++)
+        if (data[i] == '\n' && --n == 0) return i;
+    return length;
+}
+
+// Callers pass 0 < needleLength <= length.
+size_t FindSubstringScalar(const char* data, size_t length, const char* needle, size_t needleLength) {
+    const char* last = data + length - needleLength;
+    for (const char* p = data; p <= last; p++) {
+        p = (const char*)memchr(p, needle[0], last - p + 1);
+        if (!p) break;
+        if (p[needleLength - 1] == needle[needleLength - 1] && memcmp(p, needle, needleLength) == 0) return p - data;
+    }
+    return length;
+}
+
+// Crochemore-Perrin Two-Way with a last-byte shift table, as in musl's memmem. The needle
+// is split at its critical factorization; the right half is matched first, and a mismatch
+// there shifts by how far it got, so no haystack byte is compared more than twice.
+size_t FindSubstringTwoWay(const char* data, size_t length, const char* needle, size_t needleLength) {
+    const unsigned char* h = (const unsigned char*)data;
+    const unsigned char* n = (const unsigned char*)needle;
+    size_t l = needleLength;
+    size_t shift[256] = {};
+    for (size_t i = 0; i < l; i++) shift[n[i]] = i + 1;
+
+    // Maximal suffix under both byte orders; the later one is the critical position.
+    size_t ip = (size_t)-1, jp = 0, k = 1, p = 1;
+    while (jp + k < l) {
+        if (n[ip + k] == n[jp + k]) {
+            if (k == p) { jp += p; k = 1; }
+            else k++;
+        }
+        else if (n[ip + k] > n[jp + k]) { jp += k; k = 1; p = jp - ip; }
+        else { ip = jp++; k = p = 1; }
+    }
+    size_t ms = ip, p0 = p;
+    ip = (size_t)-1; jp = 0; k = p = 1;
+    while (jp + k < l) {
+        if (n[ip + k] == n[jp + k]) {
+            if (k == p) { jp += p; k = 1; }
+            else k++;
+        }
+        else if (n[ip + k] < n[jp + k]) { jp += k; k = 1; p = jp - ip; }
+        else { ip = jp++; k = p = 1; }
+    }
+    if (ip + 1 > ms + 1) ms = ip;
+    else p = p0;
+
+    // A periodic needle remembers how much of its left half already matched.
+    size_t mem0, mem = 0;
+    if (memcmp(n, n + p, ms + 1) != 0) {
+        mem0 = 0;
+        p = std::max(ms, l - ms - 1) + 1;
+    }
+    else {
+        mem0 = l - p;
+    }
+
+    size_t pos = 0;
+    while (length - pos >= l) {
+        const unsigned char* window = h + pos;
+        k = l - shift[window[l - 1]];
+        if (k) {
+            pos += std::max(k, mem);
+            mem = 0;
+            continue;
+        }
+        for (k = std::max(ms + 1, mem); k < l && n[k] == window[k]; k++) {}
+        if (k < l) {
+            pos += k - ms;
+            mem = 0;
+            continue;
+        }
+        for (k = ms + 1; k > mem && n[k - 1] == window[k - 1]; k--) {}
+        if (k <= mem) return pos;
+        pos += p;
+        mem = mem0;
+    }
+    return length;
+}
+
+#ifdef TEXT_KERNELS_X86
+
+inline int CountTrailingZeros(uint64_t x) {
+#ifdef _MSC_VER
+#ifdef _M_X64
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (int)index;
+#else
+    unsigned long index;
+    if (_BitScanForward(&index, (unsigned long)x)) return (int)index;
+    _BitScanForward(&index, (unsigned long)(x >> 32));
+    return (int)index + 32;
+#endif
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+// Position of the nth set bit of mask (1-based); the caller guarantees it exists.
+inline size_t NthSetBit(uint64_t mask, size_t n) {
+    while (--n > 0) mask &= mask - 1;
+    return (size_t)CountTrailingZeros(mask);
+}
+
+inline int PopcountPortable(uint64_t x) {
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (int)((x * 0x0101010101010101ull) >> 56);
+}
+
+#ifdef _MSC_VER
+inline int Popcount(uint64_t x) {
+#ifdef _M_X64
+    return (int)__popcnt64(x);
+#else
+    return (int)(__popcnt((unsigned)x) + __popcnt((unsigned)(x >> 32)));
+#endif
+}
+#else
+TEXT_KERNELS_TARGET("popcnt") inline int Popcount(uint64_t x) { return __builtin_popcountll(x); }
+#endif
+
+// --- SSE2: byte counters in a vector, folded with SAD every 255 iterations ---
+
+inline int SumBytes(__m128i counters) {
+    __m128i sums = _mm_sad_epu8(counters, _mm_setzero_si128());
+    return _mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4);
+}
+
+inline __m128i WhitespaceSse2(__m128i c) {
+    __m128i control = _mm_sub_epi8(c, _mm_set1_epi8(9));
+    __m128i isControl = _mm_cmpeq_epi8(_mm_min_epu8(control, _mm_set1_epi8(4)), control);
+    return _mm_or_si128(isControl, _mm_cmpeq_epi8(c, _mm_set1_epi8(' ')));
+}
+
+size_t CountNewlinesSse2(const char* data, size_t length) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t count = 0, i = 0;
+    size_t vectorEnd = length & ~(size_t)15;
+    while (i < vectorEnd) {
+        __m128i counters = _mm_setzero_si128();
+        size_t blockEnd = std::min(vectorEnd, i + 255 * 16);
+        for (; i < blockEnd; i += 16)
+            counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(data + i)), newline));
+        count += SumBytes(counters);
+    }
+    return count + CountNewlinesScalar(data + i, length - i);
+}
+
+size_t CountWordStartsSse2(const char* data, size_t length, bool& inWord) {
+    // carry holds "previous byte was a space" in byte 0.
+    __m128i carry = _mm_cvtsi32_si128(inWord ? 0 : 0xFF);
+    size_t count = 0, i = 0;
+    size_t vectorEnd = length & ~(size_t)15;
+    while (i < vectorEnd) {
+        __m128i counters = _mm_setzero_si128();
+        size_t blockEnd = std::min(vectorEnd, i + 255 * 16);
+        for (; i < blockEnd; i += 16) {
+            __m128i space = WhitespaceSse2(_mm_loadu_si128((const __m128i*)(data + i)));
+            __m128i previousSpace = _mm_or_si128(_mm_slli_si128(space, 1), carry);
+            counters = _mm_sub_epi8(counters, _mm_andnot_si128(space, previousSpace));
+            carry = _mm_srli_si128(space, 15);
+        }
+        count += SumBytes(counters);
+    }
+    inWord = (_mm_cvtsi128_si32(carry) & 0xFF) == 0;
+    return count + CountWordStartsScalar(data + i, length - i, inWord);
+}
+
+size_t FindNthNewlineSse2(const char* data, size_t length, size_t n) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t i = 0;
+    size_t vectorEnd = length & ~(size_t)15;
+    for (; i < vectorEnd; i += 16) {
+        uint64_t mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(data + i)), newline));
+        if (!mask) continue;
+        size_t count = (size_t)PopcountPortable(mask);
+        if (count >= n) return i + NthSetBit(mask, n);
+        n -= count;
+    }
+    size_t tail = FindNthNewlineScalar(data + i, length - i, n);
+    return i + tail;
+}
+
+// Checks the candidates in mask (bit i: a match may start at data + i) against the middle
+// of the needle; their first and last bytes are already known to match.
+inline size_t CheckCandidates(const char* data, uint64_t mask, const char* needle, size_t needleLength) {
+    for (; mask; mask &= mask - 1) {
+        size_t i = (size_t)CountTrailingZeros(mask);
+        if (needleLength <= 2 || memcmp(data + i + 1, needle + 1, needleLength - 2) == 0) return i;
+    }
+    return SIZE_MAX;
+}
+
+size_t FindSubstringSse2(const char* data, size_t length, const char* needle, size_t needleLength) {
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needleLength - 1]);
+    size_t starts = length - needleLength + 1;
+    size_t i = 0;
+    for (; i + 16 <= starts; i += 16) {
+        __m128i head = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(data + i)), first);
+        __m128i tail = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(data + i + needleLength - 1)), last);
+        uint64_t mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(head, tail));
+        if (!mask) continue;
+        size_t found = CheckCandidates(data + i, mask, needle, needleLength);
+        if (found != SIZE_MAX) return i + found;
+    }
+    return i + FindSubstringScalar(data + i, length - i, needle, needleLength);
+}
+
+// --- AVX2: 64-byte bit masks ---
+
+TEXT_KERNELS_TARGET("avx2,popcnt")
+inline uint64_t NewlineMaskAvx2(const char* data) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    uint32_t low = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)data), newline));
+    uint32_t high = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(data + 32)), newline));
+    return low | ((uint64_t)high << 32);
+}
+
+TEXT_KERNELS_TARGET("avx2,popcnt")
+inline uint32_t WhitespaceMaskAvx2(const char* data) {
+    __m256i c = _mm256_loadu_si256((const __m256i*)data);
+    __m256i control = _mm256_sub_epi8(c, _mm256_set1_epi8(9));
+    __m256i isControl = _mm256_cmpeq_epi8(_mm256_min_epu8(control, _mm256_set1_epi8(4)), control);
+    __m256i space = _mm256_or_si256(isControl, _mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')));
+    return (uint32_t)_mm256_movemask_epi8(space);
+}
+
+TEXT_KERNELS_TARGET("avx2,popcnt")
+size_t CountNewlinesAvx2(const char* data, size_t length) {
+    size_t count = 0, i = 0;
+    for (; i + 64 <= length; i += 64) count += Popcount(NewlineMaskAvx2(data + i));
+    return count + CountNewlinesScalar(data + i, length - i);
+}
+
+TEXT_KERNELS_TARGET("avx2,popcnt")
+size_t CountWordStartsAvx2(const char* data, size_t length, bool& inWord) {
+    uint64_t previousSpace = inWord ? 0 : 1;
+    size_t count = 0, i = 0;
+    for (; i + 64 <= length; i += 64) {
+        uint64_t space = WhitespaceMaskAvx2(data + i) | ((uint64_t)WhitespaceMaskAvx2(data + i + 32) << 32);
+        count += Popcount(~space & ((space << 1) | previousSpace));
+        previousSpace = space >> 63;
+    }
+    inWord = previousSpace == 0;
+    return count + CountWordStartsScalar(data + i, length - i, inWord);
+}
+
+TEXT_KERNELS_TARGET("avx2,popcnt")
+size_t FindNthNewlineAvx2(const char* data, size_t length, size_t n) {
+    size_t i = 0;
+    for (; i + 64 <= length; i += 64) {
+        uint64_t mask = NewlineMaskAvx2(data + i);
+        size_t count = (size_t)Popcount(mask);
+        if (count >= n) return i + NthSetBit(mask, n);
+        n -= count;
+    }
+    return i + FindNthNewlineScalar(data + i, length - i, n);
+}
+
+TEXT_KERNELS_TARGET("avx2,popcnt")
+size_t FindSubstringAvx2(const char* data, size_t length, const char* needle, size_t needleLength) {
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[needleLength - 1]);
+    size_t starts = length - needleLength + 1;
+    size_t i = 0;
+    for (; i + 32 <= starts; i += 32) {
+        __m256i head = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(data + i)), first);
+        __m256i tail = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(data + i + needleLength - 1)), last);
+        uint64_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(head, tail));
+        if (!mask) continue;
+        size_t found = CheckCandidates(data + i, mask, needle, needleLength);
+        if (found != SIZE_MAX) return i + found;
+    }
+    return i + FindSubstringScalar(data + i, length - i, needle, needleLength);
+}
+
+// --- AVX-512BW: compares straight into 64-bit mask registers ---
+
+TEXT_KERNELS_TARGET("avx512f,avx512bw,popcnt")
+size_t CountNewlinesAvx512(const char* data, size_t length) {
+    const __m512i newline = _mm512_set1_epi8('\n');
+    size_t count = 0, i = 0;
+    for (; i + 64 <= length; i += 64)
+        count += Popcount(_mm512_cmpeq_epi8_mask(_mm512_loadu_si512((const void*)(data + i)), newline));
+    return count + CountNewlinesScalar(data + i, length - i);
+}
+
+TEXT_KERNELS_TARGET("avx512f,avx512bw,popcnt")
+size_t CountWordStartsAvx512(const char* data, size_t length, bool& inWord) {
+    const __m512i nine = _mm512_set1_epi8(9), four = _mm512_set1_epi8(4), blank = _mm512_set1_epi8(' ');
+    uint64_t previousSpace = inWord ? 0 : 1;
+    size_t count = 0, i = 0;
+    for (; i + 64 <= length; i += 64) {
+        __m512i c = _mm512_loadu_si512((const void*)(data + i));
+        uint64_t space = _mm512_cmple_epu8_mask(_mm512_sub_epi8(c, nine), four) | _mm512_cmpeq_epi8_mask(c, blank);
+        count += Popcount(~space & ((space << 1) | previousSpace));
+        previousSpace = space >> 63;
+    }
+    inWord = previousSpace == 0;
+    return count + CountWordStartsScalar(data + i, length - i, inWord);
+}
+
+TEXT_KERNELS_TARGET("avx512f,avx512bw,popcnt")
+size_t FindNthNewlineAvx512(const char* data, size_t length, size_t n) {
+    const __m512i newline = _mm512_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 64 <= length; i += 64) {
+        uint64_t mask = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512((const void*)(data + i)), newline);
+        size_t count = (size_t)Popcount(mask);
+        if (count >= n) return i + NthSetBit(mask, n);
+        n -= count;
+    }
+    return i + FindNthNewlineScalar(data + i, length - i, n);
+}
+
+TEXT_KERNELS_TARGET("avx512f,avx512bw,popcnt")
+size_t FindSubstringAvx512(const char* data, size_t length, const char* needle, size_t needleLength) {
+    const __m512i first = _mm512_set1_epi8(needle[0]);
+    const __m512i last = _mm512_set1_epi8(needle[needleLength - 1]);
+    size_t starts = length - needleLength + 1;
+    size_t i = 0;
+    for (; i + 64 <= starts; i += 64) {
+        uint64_t mask = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512((const void*)(data + i)), first) &
+            _mm512_cmpeq_epi8_mask(_mm512_loadu_si512((const void*)(data + i + needleLength - 1)), last);
+        if (!mask) continue;
+        size_t found = CheckCandidates(data + i, mask, needle, needleLength);
+        if (found != SIZE_MAX) return i + found;
+    }
+    return i + FindSubstringScalar(data + i, length - i, needle, needleLength);
+}
+
+void Cpuid(int leaf, int subleaf, int out[4]) {
+#ifdef _MSC_VER
+    __cpuidex(out, leaf, subleaf);
+#else
+    unsigned a, b, c, d;
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+    out[0] = (int)a; out[1] = (int)b; out[2] = (int)c; out[3] = (int)d;
+#endif
+}
+
+uint64_t EnabledStateMask() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    uint32_t low, high;
+    __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+    return ((uint64_t)high << 32) | low;
+#endif
+}
+
+#endif // TEXT_KERNELS_X86
+
+const Kernels kernels[] = {
+    { CountNewlinesScalar, CountWordStartsScalar, FindNthNewlineScalar, FindSubstringScalar },
+#ifdef TEXT_KERNELS_X86
+    { CountNewlinesSse2, CountWordStartsSse2, FindNthNewlineSse2, FindSubstringSse2 },
+    { CountNewlinesAvx2, CountWordStartsAvx2, FindNthNewlineAvx2, FindSubstringAvx2 },
+    { CountNewlinesAvx512, CountWordStartsAvx512, FindNthNewlineAvx512, FindSubstringAvx512 },
+#endif
+};
+
+Isa Detect() {
+#ifdef TEXT_KERNELS_X86
+    int regs[4];
+    Cpuid(0, 0, regs);
+    int maxLeaf = regs[0];
+    Cpuid(1, 0, regs);
+    bool sse2 = (regs[3] & (1 << 26)) != 0;
+    bool popcnt = (regs[2] & (1 << 23)) != 0;
+    bool osxsave = (regs[2] & (1 << 27)) != 0;
+    bool avx = (regs[2] & (1 << 28)) != 0;
+    if (!sse2) return Isa::Scalar;
+    if (!osxsave || !avx || !popcnt || maxLeaf < 7) return Isa::SSE2;
+
+    // The OS must save the YMM (and for AVX-512, opmask/ZMM) state across context switches.
+    uint64_t state = EnabledStateMask();
+    Cpuid(7, 0, regs);
+    bool avx2 = (regs[1] & (1 << 5)) != 0 && (state & 0x6) == 0x6;
+    bool avx512 = (regs[1] & (1 << 16)) != 0 && (regs[1] & (1 << 30)) != 0 && (state & 0xE6) == 0xE6;
+    if (avx2 && avx512) return Isa::AVX512;
+    if (avx2) return Isa::AVX2;
+    return Isa::SSE2;
+#else
+    return Isa::Scalar;
+#endif
+}
+
+const Isa detected = Detect();
+std::atomic<const Kernels*> active{ &kernels[(int)detected] };
+
+}
+
+Isa DetectedIsa() { return detected; }
+
+Isa ActiveIsa() { return (Isa)(active.load(std::memory_order_relaxed) - kernels); }
+
+void SetIsa(Isa isa) {
+    if ((int)isa > (int)detected) isa = detected;
+    active.store(&kernels[(int)isa], std::memory_order_relaxed);
+}
+
+const char* IsaName(Isa isa) {
+    switch (isa) {
+    case Isa::SSE2: return "SSE2";
+    case Isa::AVX2: return "AVX2";
+    case Isa::AVX512: return "AVX-512";
+    default: return "Scalar";
+    }
+}
+
+size_t CountNewlines(const char* data, size_t length) {
+    return active.load(std::memory_order_relaxed)->countNewlines(data, length);
+}
+
+size_t CountWordStarts(const char* data, size_t length, bool& inWord) {
+    return active.load(std::memory_order_relaxed)->countWordStarts(data, length, inWord);
+}
+
+size_t FindNthNewline(const char* data, size_t length, size_t n) {
+    if (n == 0) return length;
+    return active.load(std::memory_order_relaxed)->findNthNewline(data, length, n);
+}
+
+size_t FindSubstring(const char* data, size_t length, const char* needle, size_t needleLength) {
+    if (needleLength == 0) return 0;
+    if (needleLength > length) return length;
+    if (needleLength > LongNeedle) return FindSubstringTwoWay(data, length, needle, needleLength);
+    return active.load(std::memory_order_relaxed)->findSubstring(data, length, needle, needleLength);
+}
+
+}
@@ -0,0 +1,143 @@
+#include "TextSearch.h"
+#include "TextKernels.h"
+#include <algorithm>
+
+namespace TextSearch {
+
+namespace {
+
+// Bytes searched per step of FindPrevious.
+constexpr size_t BackwardWindow = 1024 * 1024;
+
+// Literal search resuming step bytes after the start of each match: n for ForEachMatch,
+// 1 for ForEachOccurrence.
+void Scan(const PieceTable& document, const std::string& needle, size_t pos, size_t length, size_t step,
+    const std::function<bool(size_t)>& fn) {
+    size_t n = needle.size();
+    if (n == 0 || pos >= document.Size()) return;
+    length = std::min(length, document.Size() - pos);
+    if (length < n) return;
+
+    std::string carry;          // the last n - 1 bytes before the current span
+    size_t carryStart = pos;    // document offset of carry[0]
+    size_t next = pos;          // where the next match may start
+    std::string bridge;
+    document.ForEachSpan(pos, length, [&](const char* data, size_t size) {
+        size_t spanStart = carryStart + carry.size();
+        // Matches that start in carry and end in this span.
+        if (!carry.empty()) {
+            bridge.assign(carry);
+            bridge.append(data, std::min(size, n - 1));
+            size_t from = next > carryStart ? next - carryStart : 0;
+            while (from < carry.size()) {
+                size_t found = from + TextKernels::FindSubstring(bridge.data() + from, bridge.size() - from, needle.data(), n);
+                if (found >= carry.size()) break;
+                if (!fn(carryStart + found)) return false;
+                next = carryStart + found + step;
+                from = found + step;
+            }
+        }
+        size_t from = next > spanStart ? next - spanStart : 0;
+        while (from + n <= size) {
+            size_t found = from + TextKernels::FindSubstring(data + from, size - from, needle.data(), n);
+            if (found == size) break;
+            if (!fn(spanStart + found)) return false;
+            next = spanStart + found + step;
+            from = found + step;
+        }
+        if (size >= n - 1) {
+            carry.assign(data + size - (n - 1), n - 1);
+        }
+        else {
+            carry.append(data, size);
+            if (carry.size() > n - 1) carry.erase(0, carry.size() - (n - 1));
+        }
+        carryStart = spanStart + size - carry.size();
+        return true;
+    });
+}
+
+}
+
+void ForEachMatch(const PieceTable& document, const std::string& needle, size_t pos, size_t length,
+    const std::function<bool(size_t)>& fn) {
+    Scan(document, needle, pos, length, needle.size(), fn);
+}
+
+void ForEachOccurrence(const PieceTable& document, const std::string& needle, size_t pos, size_t length,
+    const std::function<bool(size_t)>& fn) {
+    Scan(document, needle, pos, length, 1, fn);
+}
+
+size_t FindNext(const PieceTable& document, const std::string& needle, size_t from) {
+    size_t result = NotFound;
+    if (from < document.Size())
+        ForEachMatch(document, needle, from, document.Size() - from, [&](size_t offset) {
+            result = offset;
+            return false;
+        });
+    return result;
+}
+
+size_t FindPrevious(const PieceTable& document, const std::string& needle, size_t before) {
+    if (needle.empty()) return NotFound;
+    size_t end = std::min(before, document.Size());
+    while (end > 0) {
+        size_t begin = end > BackwardWindow ? end - BackwardWindow : 0;
+        // Matches start in [begin, end) but may run past end. Overlapping ones are all
+        // seen, so the result doesn't depend on where the window starts.
+        size_t limit = std::min(end + needle.size() - 1, document.Size());
+        size_t result = NotFound;
+        ForEachOccurrence(document, needle, begin, limit - begin, [&](size_t offset) {
+            if (offset >= end) return false;
+            result = offset;
+            return true;
+        });
+        if (result != NotFound) return result;
+        end = begin;
+    }
+    return NotFound;
+}
+
+void ForEachMatch(const PieceTable& document, Regex& regex, size_t pos, size_t length,
+    const std::function<bool(size_t, size_t)>& fn) {
+    if (regex.Empty() || pos > document.Size()) return;
+    size_t end = pos + std::min(length, document.Size() - pos);
+    size_t matchStart, matchEnd;
+    while (pos <= end && regex.Find(document, pos, end, matchStart, matchEnd)) {
+        if (!fn(matchStart, matchEnd - matchStart)) return;
+        pos = matchEnd > matchStart ? matchEnd : matchStart + 1;
+    }
+}
+
+size_t FindNext(const PieceTable& document, Regex& regex, size_t from, size_t& length) {
+    size_t matchStart, matchEnd;
+    if (regex.Empty() || from > document.Size() || !regex.Find(document, from, document.Size(), matchStart, matchEnd))
+        return NotFound;
+    length = matchEnd - matchStart;
+    return matchStart;
+}
+
+size_t FindPrevious(const PieceTable& document, Regex& regex, size_t before, size_t& length) {
+    if (regex.Empty()) return NotFound;
+    size_t end = std::min(before, document.Size());
+    // A match starting before end can run on to the end of its line.
+    size_t line, column;
+    document.LineColumn(end, line, column);
+    size_t limit = document.LineEnd(line);
+    for (;;) {
+        document.LineColumn(end > BackwardWindow ? end - BackwardWindow : 0, line, column);
+        size_t begin = document.LineStart(line);
+        size_t result = NotFound;
+        ForEachMatch(document, regex, begin, limit - begin, [&](size_t offset, size_t matchLength) {
+            if (offset >= end) return false;
+            result = offset;
+            length = matchLength;
+            return true;
+        });
+        if (result != NotFound || begin == 0) return result;
+        end = limit = begin;
+    }
+}
+
+}
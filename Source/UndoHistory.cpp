@@ -0,0 +1,120 @@
+#include "UndoHistory.h"
+
+static size_t TotalBytes(const std::vector<Piece>& pieces) {
+    size_t bytes = 0;
+    for (const Piece& piece : pieces) bytes += piece.length;
+    return bytes;
+}
+
+static bool HasNewline(const std::vector<Piece>& pieces) {
+    for (const Piece& piece : pieces)
+        if (piece.newlines > 0) return true;
+    return false;
+}
+
+size_t UndoHistory::Cost(const Step& step) {
+    return sizeof(Step) + (step.removed.capacity() + step.inserted.capacity()) * sizeof(Piece);
+}
+
+// Appends pieces, joining the first one onto the last piece of to when their bytes are
+// adjacent; consecutive keystrokes land next to each other in the add buffer.
+void UndoHistory::AppendPieces(std::vector<Piece>& to, const std::vector<Piece>& pieces) {
+    size_t i = 0;
+    if (!to.empty() && !pieces.empty()) {
+        Piece& last = to.back();
+        if (last.data + last.length == pieces[0].data && last.length + pieces[0].length <= Rope::MaxChunk) {
+            last.length += pieces[0].length;
+            last.newlines += pieces[0].newlines;
+            i = 1;
+        }
+    }
+    to.insert(to.end(), pieces.begin() + i, pieces.end());
+}
+
+bool UndoHistory::Merge(Step& step, size_t offset, const std::vector<Piece>& removed, size_t removedBytes,
+    const std::vector<Piece>& inserted, size_t insertedBytes) {
+    size_t before = Cost(step);
+    if (removedBytes == 0 && step.removedBytes == 0 && offset == step.offset + step.insertedBytes) {
+        AppendPieces(step.inserted, inserted);
+        step.insertedBytes += insertedBytes;
+    }
+    else if (insertedBytes == 0 && step.insertedBytes == 0 && offset + removedBytes == step.offset) {
+        // Backspace: the new bytes come before the ones already removed.
+        std::vector<Piece> joined(removed);
+        AppendPieces(joined, step.removed);
+        step.removed.swap(joined);
+        step.offset = offset;
+        step.removedBytes += removedBytes;
+    }
+    else if (insertedBytes == 0 && step.insertedBytes == 0 && offset == step.offset) {
+        // Forward delete.
+        AppendPieces(step.removed, removed);
+        step.removedBytes += removedBytes;
+    }
+    else {
+        return false;
+    }
+    memoryUsed = memoryUsed - before + Cost(step);
+    return true;
+}
+
+void UndoHistory::Record(size_t offset, std::vector<Piece> removed, std::vector<Piece> inserted, bool typing) {
+    size_t removedBytes = TotalBytes(removed);
+    size_t insertedBytes = TotalBytes(inserted);
+    if (removedBytes == 0 && insertedBytes == 0) return;
+    bool newline = HasNewline(inserted);
+
+    // A new edit discards whatever could have been redone.
+    while (steps.size() > applied) {
+        memoryUsed -= Cost(steps.back());
+        steps.pop_back();
+    }
+    if (savedAt != NoSavePoint && savedAt > applied) savedAt = NoSavePoint;
+
+    bool merged = typing && merging && applied > 0 && savedAt != applied &&
+        Merge(steps.back(), offset, removed, removedBytes, inserted, insertedBytes);
+    if (!merged) {
+        steps.push_back(Step{ offset, std::move(removed), std::move(inserted), removedBytes, insertedBytes });
+        memoryUsed += Cost(steps.back());
+        applied++;
+    }
+    merging = typing && !newline;
+    Trim();
+}
+
+void UndoHistory::Trim() {
+    while (memoryUsed > budget && !steps.empty()) {
+        if (applied == 0) {
+            // Only redo steps are left and they depend on each other; drop them all.
+            steps.clear();
+            memoryUsed = 0;
+            if (savedAt != 0) savedAt = NoSavePoint;
+            break;
+        }
+        memoryUsed -= Cost(steps.front());
+        steps.pop_front();
+        applied--;
+        savedAt = savedAt == NoSavePoint || savedAt == 0 ? NoSavePoint : savedAt - 1;
+    }
+    if (applied == 0) merging = false;
+}
+
+const UndoHistory::Step* UndoHistory::Undo() {
+    if (applied == 0) return nullptr;
+    merging = false;
+    return &steps[--applied];
+}
+
+const UndoHistory::Step* UndoHistory::Redo() {
+    if (applied == steps.size()) return nullptr;
+    merging = false;
+    return &steps[applied++];
+}
+
+void UndoHistory::Clear() {
+    steps.clear();
+    applied = 0;
+    savedAt = 0;
+    merging = false;
+    memoryUsed = 0;
+}
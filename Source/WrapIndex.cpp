@@ -0,0 +1,294 @@
+#include "WrapIndex.h"
+#include <algorithm>
+#include <cmath>
+
+WrapIndex::NodePtr WrapIndex::MakeLeaf(std::vector<uint32_t> items) {
+    auto node = std::make_unique<Node>();
+    node->leaf = true;
+    for (uint32_t entry : items) {
+        node->rows += entry & CountMask;
+        if (!(entry & Measured)) node->unmeasured++;
+    }
+    node->lines = items.size();
+    node->items = std::move(items);
+    return node;
+}
+
+WrapIndex::NodePtr WrapIndex::MakeInternal(NodeList children) {
+    auto node = std::make_unique<Node>();
+    node->leaf = false;
+    for (const NodePtr& child : children) {
+        node->lines += child->lines;
+        node->rows += child->rows;
+        node->unmeasured += child->unmeasured;
+    }
+    node->children = std::move(children);
+    return node;
+}
+
+// As in Rope, both splitters spread the entries evenly over the fewest nodes that fit.
+WrapIndex::NodeList WrapIndex::SplitLeaves(std::vector<uint32_t> items) {
+    NodeList out;
+    if (items.empty()) return out;
+    if (items.size() <= MaxLeafLines) {
+        out.push_back(MakeLeaf(std::move(items)));
+        return out;
+    }
+    size_t groups = (items.size() + MaxLeafLines - 1) / MaxLeafLines;
+    size_t begin = 0;
+    for (size_t g = 0; g < groups; g++) {
+        size_t end = items.size() * (g + 1) / groups;
+        out.push_back(MakeLeaf(std::vector<uint32_t>(items.begin() + begin, items.begin() + end)));
+        begin = end;
+    }
+    return out;
+}
+
+WrapIndex::NodeList WrapIndex::SplitInternal(NodeList children) {
+    NodeList out;
+    if (children.empty()) return out;
+    size_t groups = (children.size() + MaxEntries - 1) / MaxEntries;
+    size_t begin = 0;
+    for (size_t g = 0; g < groups; g++) {
+        size_t end = children.size() * (g + 1) / groups;
+        out.push_back(MakeInternal(NodeList(std::make_move_iterator(children.begin() + begin),
+            std::make_move_iterator(children.begin() + end))));
+        begin = end;
+    }
+    return out;
+}
+
+void WrapIndex::Rebalance(NodeList& nodes, size_t from, size_t to) {
+    // Merge underfull nodes produced by a splice with a neighbour, then re-split.
+    size_t i = from > 0 ? from - 1 : 0;
+    to = std::min(to + 1, nodes.size());
+    while (i < to && nodes.size() > 1) {
+        if (!nodes[i]->Small()) { i++; continue; }
+        size_t left = i + 1 < nodes.size() ? i : i - 1;
+        Node& a = *nodes[left];
+        Node& b = *nodes[left + 1];
+        NodeList merged;
+        if (a.leaf) {
+            a.items.insert(a.items.end(), b.items.begin(), b.items.end());
+            merged = SplitLeaves(std::move(a.items));
+        }
+        else {
+            for (NodePtr& child : b.children) a.children.push_back(std::move(child));
+            merged = SplitInternal(std::move(a.children));
+        }
+        nodes.erase(nodes.begin() + left, nodes.begin() + left + 2);
+        nodes.insert(nodes.begin() + left, std::make_move_iterator(merged.begin()), std::make_move_iterator(merged.end()));
+        to = std::min(to, nodes.size());
+        i = left;
+    }
+}
+
+WrapIndex::NodeList WrapIndex::SpliceNode(NodePtr node, size_t line, size_t removed, size_t inserted) {
+    if (node->leaf) {
+        std::vector<uint32_t>& items = node->items;
+        items.erase(items.begin() + line, items.begin() + line + removed);
+        items.insert(items.begin() + line, inserted, 1);
+        return SplitLeaves(std::move(items));
+    }
+
+    NodeList& children = node->children;
+    size_t c = 0, base = 0;
+    while (c + 1 < children.size()) {
+        size_t end = base + children[c]->lines;
+        if (line < end || (line == end && removed == 0)) break;
+        base = end;
+        c++;
+    }
+
+    NodeList result(std::make_move_iterator(children.begin()), std::make_move_iterator(children.begin() + c));
+    size_t fixFrom = result.size();
+
+    size_t local = line - base;
+    size_t take = std::min(removed, children[c]->lines - local);
+    NodeList first = SpliceNode(std::move(children[c]), local, take, inserted);
+    result.insert(result.end(), std::make_move_iterator(first.begin()), std::make_move_iterator(first.end()));
+
+    // Children entirely inside the removed range are dropped without being visited.
+    size_t remaining = removed - take;
+    size_t next = c + 1;
+    while (remaining > 0 && next < children.size() && remaining >= children[next]->lines) {
+        remaining -= children[next]->lines;
+        next++;
+    }
+    if (remaining > 0 && next < children.size()) {
+        NodeList last = SpliceNode(std::move(children[next]), 0, remaining, 0);
+        result.insert(result.end(), std::make_move_iterator(last.begin()), std::make_move_iterator(last.end()));
+        next++;
+    }
+    size_t fixTo = result.size();
+    result.insert(result.end(), std::make_move_iterator(children.begin() + next), std::make_move_iterator(children.end()));
+
+    Rebalance(result, fixFrom, fixTo);
+    return SplitInternal(std::move(result));
+}
+
+WrapIndex::NodePtr WrapIndex::BuildUp(NodeList level) {
+    while (level.size() > 1) level = SplitInternal(std::move(level));
+    NodePtr top = level.empty() ? nullptr : std::move(level[0]);
+    while (top && !top->leaf && top->children.size() == 1) top = std::move(top->children[0]);
+    return top;
+}
+
+void WrapIndex::Reset(size_t lineCount, float newWidth) {
+    width = newWidth;
+    NodeList leaves;
+    size_t groups = (lineCount + MaxLeafLines - 1) / MaxLeafLines;
+    for (size_t g = 0; g < groups; g++)
+        leaves.push_back(MakeLeaf(std::vector<uint32_t>(lineCount * (g + 1) / groups - lineCount * g / groups, 1)));
+    root = BuildUp(std::move(leaves));
+}
+
+void WrapIndex::Scale(Node& node, double scale) {
+    node.rows = 0;
+    node.unmeasured = node.lines;
+    if (node.leaf) {
+        for (uint32_t& entry : node.items) {
+            double estimate = std::round((entry & CountMask) * scale);
+            entry = (uint32_t)std::min<double>(std::max(estimate, 1.0), CountMask);
+            node.rows += entry;
+        }
+        return;
+    }
+    for (NodePtr& child : node.children) {
+        Scale(*child, scale);
+        node.rows += child->rows;
+    }
+}
+
+void WrapIndex::Rescale(float newWidth) {
+    double scale = width > 0.0f && newWidth > 0.0f ? (double)width / newWidth : 1.0;
+    width = newWidth;
+    if (root) Scale(*root, scale);
+}
+
+void WrapIndex::Replace(size_t line, size_t removed, size_t inserted) {
+    line = std::min(line, LineCount());
+    removed = std::min(removed, LineCount() - line);
+    if (removed == inserted) {
+        // Same lines, new text: keep the old counts as estimates.
+        for (size_t i = line; i < line + removed; i++) Update(i, Entry(i) & CountMask);
+        return;
+    }
+    if (!root) {
+        Reset(inserted, width);
+        return;
+    }
+    root = BuildUp(SpliceNode(std::move(root), line, removed, inserted));
+}
+
+void WrapIndex::SetRows(size_t line, size_t count) {
+    count = std::min<size_t>(std::max<size_t>(count, 1), CountMask);
+    Update(line, (uint32_t)count | Measured);
+}
+
+uint32_t WrapIndex::Entry(size_t line) const {
+    const Node* node = root.get();
+    while (!node->leaf) {
+        for (const NodePtr& child : node->children) {
+            if (line < child->lines) { node = child.get(); break; }
+            line -= child->lines;
+        }
+    }
+    return node->items[line];
+}
+
+void WrapIndex::Update(size_t line, uint32_t entry) {
+    // The path is at most a handful of nodes deep; it's walked again to apply the change.
+    Node* node = root.get();
+    size_t index = line;
+    while (!node->leaf) {
+        for (const NodePtr& child : node->children) {
+            if (index < child->lines) { node = child.get(); break; }
+            index -= child->lines;
+        }
+    }
+    uint32_t old = node->items[index];
+    if (old == entry) return;
+    int64_t rows = (int64_t)(entry & CountMask) - (int64_t)(old & CountMask);
+    int64_t unmeasured = (int64_t)!(entry & Measured) - (int64_t)!(old & Measured);
+    node->items[index] = entry;
+    node = root.get();
+    index = line;
+    for (;;) {
+        node->rows += rows;
+        node->unmeasured += unmeasured;
+        if (node->leaf) break;
+        for (const NodePtr& child : node->children) {
+            if (index < child->lines) { node = child.get(); break; }
+            index -= child->lines;
+        }
+    }
+}
+
+uint64_t WrapIndex::RowOf(size_t line) const {
+    uint64_t row = 0;
+    if (!root) return row;
+    const Node* node = root.get();
+    line = std::min(line, node->lines);
+    while (!node->leaf) {
+        const Node* next = node->children.back().get();
+        for (const NodePtr& child : node->children) {
+            if (line < child->lines) { next = child.get(); break; }
+            line -= child->lines;
+            row += child->rows;
+        }
+        node = next;
+    }
+    for (size_t i = 0; i < line && i < node->items.size(); i++) row += node->items[i] & CountMask;
+    return row;
+}
+
+size_t WrapIndex::LineAtRow(uint64_t row, size_t& rowInLine) const {
+    if (!root || root->lines == 0) {
+        rowInLine = 0;
+        return 0;
+    }
+    if (row >= root->rows) {
+        rowInLine = Rows(root->lines - 1) - 1;
+        return root->lines - 1;
+    }
+    const Node* node = root.get();
+    size_t line = 0;
+    while (!node->leaf) {
+        for (const NodePtr& child : node->children) {
+            if (row < child->rows) { node = child.get(); break; }
+            row -= child->rows;
+            line += child->lines;
+        }
+    }
+    size_t i = 0;
+    while (row >= (node->items[i] & CountMask)) row -= node->items[i++] & CountMask;
+    rowInLine = (size_t)row;
+    return line + i;
+}
+
+size_t WrapIndex::FindUnmeasured(const Node& node, size_t from) {
+    if (node.unmeasured == 0 || from >= node.lines) return node.lines;
+    if (node.leaf) {
+        for (size_t i = from; i < node.items.size(); i++)
+            if (!(node.items[i] & Measured)) return i;
+        return node.lines;
+    }
+    // Only the child holding from can come up empty; any later one with unmeasured
+    // lines has the answer.
+    size_t base = 0;
+    for (const NodePtr& child : node.children) {
+        if (from < base + child->lines && child->unmeasured > 0) {
+            size_t found = FindUnmeasured(*child, from > base ? from - base : 0);
+            if (found < child->lines) return base + found;
+        }
+        base += child->lines;
+    }
+    return node.lines;
+}
+
+size_t WrapIndex::NextUnmeasured(size_t from) const {
+    if (Unmeasured() == 0) return LineCount();
+    size_t found = FindUnmeasured(*root, from);
+    return found < LineCount() ? found : FindUnmeasured(*root, 0);
+}
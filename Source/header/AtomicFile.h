@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Writes a file by streaming into a temporary file in the same directory and renaming
+// it over the destination once the data is on disk, so a crash at any point leaves
+// either the old file or the complete new one.
+class AtomicFile {
+public:
+    AtomicFile() : handle(-1), committed(false) {}
+    ~AtomicFile();
+    AtomicFile(const AtomicFile&) = delete;
+    AtomicFile& operator=(const AtomicFile&) = delete;
+
+    bool Open(const std::string& path, std::string& error);
+
+    // Queues [data, data + length) without copying; the bytes must stay valid until
+    // Finish. Adjacent spans are merged and written with few large system calls.
+    bool Write(const char* data, size_t length);
+
+    // Writes what is queued, flushes the temporary file to disk and closes it.
+    bool Finish(std::string& error);
+    // Renames the finished temporary file over the destination. On Windows a destination
+    // that is memory-mapped (MappedFile opens with FILE_SHARE_DELETE) can't be replaced but
+    // can be renamed: it is moved aside and deleted, which completes when it is unmapped.
+    bool Commit(std::string& error);
+
+    const std::string& TempPath() const { return tempPath; }
+
+private:
+    // Spans gathered per system call; matches the usual IOV_MAX.
+    static constexpr size_t MaxSpans = 1024;
+
+    bool Flush();
+    void Close();
+
+    std::string path;
+    std::string tempPath;
+    intptr_t handle;    // file descriptor, or HANDLE on Windows; -1 when closed
+    struct Span { const char* data; size_t length; };
+    std::vector<Span> pending;
+    std::string failure;
+    bool committed;
+};
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Command-line benchmarks, run as `TextEditor --bench <name> [args]`.
+// Returns the process exit code.
+int RunBenchmark(int argc, char** argv);
+
+// Writes a log-like file of roughly sizeMiB mebibytes, for benchmarks that open files.
+bool GenerateLogFile(const std::string& path, size_t sizeMiB);
+
+// Value of a numeric option such as --size-mb N among args, or fallback when it isn't given.
+size_t OptionValue(int argc, char** argv, const char* name, size_t fallback);
@@ -0,0 +1,183 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <imgui.h>
+#include "LayoutCache.h"
+#include "LineSegments.h"
+#include "PieceTable.h"
+#include "Regex.h"
+#include "WrapIndex.h"
+
+// Editing widget that draws a PieceTable directly. Scrolling is kept as a line index
+// (plus a row within it when wrapping), and every frame only the lines inside the visible
+// area are read from the document, laid out and drawn, so the cost of a frame doesn't
+// depend on the document's size. The view never modifies the document itself: edits are
+// handed to an EditHandler, and the owner reports them back through TextChanged().
+class EditorView {
+public:
+    // Replaces [start, start + removed) with text. Returns false if the edit was rejected.
+    using EditHandler = std::function<bool(size_t start, size_t removed, const std::string& text, bool typing)>;
+
+    EditorView() : cursor(0), anchor(0), topLine(0), topRow(0), scrollX(0.0), preferredX(-1.0), visibleLines(1),
+        lineHeight(1.0f), blinkStart(0.0), focused(false), scrollToCursor(false), focusRequested(false), grabOffset(0.0f),
+        wrap(false), wrapWidth(0.0f), refineNext(0), contentWidth(0.0), highlightRegex(nullptr) {}
+
+    // Draws the view into a region of size at the current layout position and handles
+    // mouse and keyboard input while it has focus.
+    void Render(const char* id, const PieceTable& document, const ImVec2& size, bool readOnly, const EditHandler& edit);
+
+    size_t Cursor() const { return cursor; }
+    size_t SelectionStart() const { return std::min(cursor, anchor); }
+    size_t SelectionEnd() const { return std::max(cursor, anchor); }
+    bool HasSelection() const { return cursor != anchor; }
+
+    // Moves the cursor (clearing the selection) and scrolls it into view on the next frame.
+    void SetCursor(size_t offset) { cursor = anchor = offset; preferredX = -1.0; scrollToCursor = true; }
+    // Selects [start, end) with the cursor at end, scrolled into view like SetCursor.
+    void Select(size_t start, size_t end) { anchor = start; cursor = end; preferredX = -1.0; scrollToCursor = true; }
+    // Occurrences of text on screen are highlighted (the Find text); empty for none.
+    void SetHighlight(const std::string& text) {
+        highlight = text;
+        highlightRegex = nullptr;
+    }
+    // Or matches of a regular expression, which is searched with while drawing; nullptr
+    // for none.
+    void SetHighlight(Regex* regex) {
+        highlight.clear();
+        highlightRegex = regex && !regex->Empty() ? regex : nullptr;
+    }
+    void Focus() { focusRequested = true; }
+    // Whether the view had keyboard focus in the last frame it was rendered.
+    bool Focused() const { return focused; }
+    // Back to the top of a new document.
+    void Reset() {
+        cursor = anchor = 0;
+        topLine = topRow = 0;
+        scrollX = 0.0;
+        preferredX = -1.0;
+        wraps.Reset(0, 0.0f);
+        longLines.clear();
+    }
+
+    // Lines [line, line + removedLines] of the document were replaced by
+    // [line, line + insertedLines]; their wrapping is measured again.
+    void TextChanged(size_t line, size_t removedLines, size_t insertedLines);
+
+    // Word wrap at the width of the view. Lines are measured lazily: those on screen right
+    // away, the rest a slice per frame while Reflowing(), with estimates in the meantime.
+    void SetWrap(bool enabled);
+    bool Wrap() const { return wrap; }
+    bool Reflowing() const { return wrap && wraps.Unmeasured() > 0; }
+
+    // Seconds until the cursor blinks on or off, or -1 when it isn't blinking.
+    double BlinkTimeout() const;
+
+    // Glyph layouts of recently drawn lines. Clear it when the font atlas is rebuilt.
+    LayoutCache& Layouts() { return layouts; }
+
+    size_t TopLine() const { return topLine; }
+    // Rows that fit in the view as of the last Render.
+    size_t VisibleLines() const { return visibleLines; }
+    void SetTopLine(size_t line) { topLine = line; topRow = 0; }
+
+private:
+    // Lines longer than this are laid out in LineSegments, only where they are on screen.
+    static constexpr size_t MaxLayoutBytes = 64 * 1024;
+    // Segment indexes kept for long lines, dropped all at once past this.
+    static constexpr size_t MaxLongLines = 64;
+
+    // Time spent measuring wrapped lines off screen per frame.
+    static constexpr double RefineSeconds = 0.002;
+
+    // One laid-out line: its document offset, its text, and the first glyph of each visual
+    // row; a single row when not wrapping. A long line has segments instead, and an empty
+    // text and layout; when wrapping, its rows are those of its segments, each laid out
+    // as a Line of its own by SegmentLine().
+    struct Line {
+        size_t start;
+        size_t length;
+        std::string text;
+        std::shared_ptr<const LineLayout> layout;
+        std::vector<uint32_t> rows;
+        LineSegments* segments = nullptr;
+    };
+
+    void ReadLine(const PieceTable& document, size_t line, Line& out);
+    size_t OffsetAt(const PieceTable& document, const ImVec2& origin, const ImVec2& mouse);
+
+    // Visual rows: row r of a line covers glyphs [rows[r], rows[r + 1]).
+    size_t RowCount(const Line& line) const;
+    static size_t RowOfColumn(const Line& line, size_t column);
+    size_t RowOfColumn(const PieceTable& document, const Line& line, size_t column);
+    // The Line holding a row: line itself, or the segment of a wrapped long line, laid out
+    // into segment. row becomes the row within it.
+    const Line& RowLine(const PieceTable& document, const Line& line, size_t& row, Line& segment);
+    static float RowLeft(const Line& line, size_t row);
+    size_t ColumnInRow(const PieceTable& document, const Line& line, size_t row, double x);
+    // x of a byte column from the start of the line, and the column nearest to x.
+    double ColumnX(const PieceTable& document, const Line& line, size_t column);
+    size_t XColumn(const PieceTable& document, const Line& line, double x);
+
+    // Segments of a long line: where one starts (moved forward to a character boundary),
+    // which one holds a column, and its layout, which also measures it.
+    size_t SegmentStart(const PieceTable& document, const Line& line, size_t segment) const;
+    size_t SegmentOf(const PieceTable& document, const Line& line, size_t column) const;
+    std::shared_ptr<const LineLayout> SegmentLayout(const PieceTable& document, const Line& line, size_t segment, size_t& begin);
+    // A segment laid out and wrapped as a Line, which also counts its rows.
+    void SegmentLine(const PieceTable& document, const Line& line, size_t segment, Line& out);
+    // Moves (line, row) by delta visual rows, stopping at the first and last rows.
+    void StepRows(const PieceTable& document, size_t& line, size_t& row, long long delta);
+    uint64_t TotalRows(const PieceTable& document) const;
+    uint64_t TopRow() const;
+    void SetTopRow(const PieceTable& document, uint64_t row);
+    void SyncWraps(const PieceTable& document);
+    void RefineWraps(const PieceTable& document);
+
+    void HandleMouse(const PieceTable& document, const ImVec2& origin, const ImVec2& size);
+    void HandleKeyboard(const PieceTable& document, bool readOnly, const EditHandler& edit);
+    void MoveTo(size_t offset, bool select);
+    void MoveVertical(const PieceTable& document, long long rows, bool select);
+    bool Replace(size_t start, size_t removed, const std::string& text, bool typing, const EditHandler& edit);
+    void ScrollBy(const PieceTable& document, long long rows);
+    void EnsureCursorVisible(const PieceTable& document, float width);
+    void RenderScrollbar(const PieceTable& document, const ImVec2& origin, const ImVec2& size);
+    void RenderHorizontalScrollbar(const ImVec2& origin, const ImVec2& size, float viewWidth);
+    void Draw(const PieceTable& document, const ImVec2& origin, const ImVec2& size);
+    // Calls fn(start, end) for each highlighted match starting in [from, to), until it
+    // returns false.
+    void ForEachHighlight(const PieceTable& document, size_t from, size_t to,
+        const std::function<bool(size_t start, size_t end)>& fn);
+    void DrawSegments(const PieceTable& document, const Line& line, float y, float textLeft, float clipLeft, float clipRight,
+        bool drawCursor);
+
+    size_t cursor;
+    size_t anchor;          // other end of the selection; equal to cursor when there is none
+    size_t topLine;         // first visible line
+    size_t topRow;          // first visible row of topLine
+    double scrollX;         // double: long lines are wider than a float can address to the pixel
+    double preferredX;      // x kept while moving up and down, or -1
+    size_t visibleLines;
+    float lineHeight;
+    double blinkStart;
+    bool focused;           // as of the last Render
+    bool scrollToCursor;
+    bool focusRequested;
+    float grabOffset;       // where the scrollbar thumb was grabbed
+    LayoutCache layouts;
+    bool wrap;
+    float wrapWidth;
+    WrapIndex wraps;
+    size_t refineNext;      // where measuring off-screen lines resumes
+    std::unordered_map<size_t, LineSegments> longLines;     // by line number
+    double contentWidth;    // widest line drawn in the last frame
+    std::string highlight;
+    Regex* highlightRegex;
+    std::vector<std::pair<size_t, size_t>> matches;     // highlighted in the line being drawn
+};
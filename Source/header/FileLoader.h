@@ -0,0 +1,72 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MappedFile.h"
+#include "Rope.h"
+
+// Opens a file on a worker thread and indexes it into pieces in batches, so the UI can
+// show the beginning of a large file while the rest is still being scanned. The UI
+// thread calls Poll() once per frame and appends what arrived to its document.
+class FileLoader {
+public:
+    // A contiguous run of the file, already split into pieces with newline counts.
+    struct Batch {
+        std::vector<Piece> pieces;
+        size_t bytes = 0;
+        size_t wordStarts = 0;
+    };
+
+    struct Update {
+        std::string path;
+        std::shared_ptr<const MappedFile> file;   // set once, when the file has been opened
+        std::vector<Batch> batches;
+        bool finished = false;
+        std::string error;
+    };
+
+    FileLoader() : cancelled(false), loadedBytes(0), totalBytes(0), running(false) {}
+    ~FileLoader() { Cancel(); }
+    FileLoader(const FileLoader&) = delete;
+    FileLoader& operator=(const FileLoader&) = delete;
+
+    // Cancels any load in progress and starts loading path. maxReadBytes limits files
+    // that can't be mapped and have to be read into memory.
+    void Start(const std::string& path, size_t maxReadBytes);
+    // Stops the worker and discards everything it hasn't delivered yet.
+    void Cancel();
+    // Called on the worker thread whenever there is something new to Poll(), so an idle UI
+    // can wake up. Set it while no load is running.
+    void SetNotify(std::function<void()> callback) { notify = std::move(callback); }
+
+    // Moves the worker's output into update. Returns false when there is nothing to report.
+    bool Poll(Update& update);
+
+    bool Busy() const { return running; }
+    size_t LoadedBytes() const { return loadedBytes; }
+    // Zero until the file is open.
+    size_t TotalBytes() const { return totalBytes; }
+
+private:
+    // The first batch is small so it arrives quickly; later ones grow to amortize the handoff.
+    static constexpr size_t FirstBatch = 256 * 1024;
+    static constexpr size_t MaxBatch = 16 * 1024 * 1024;
+
+    void Run(std::string path, size_t maxReadBytes);
+    void Notify() { if (notify) notify(); }
+
+    std::thread worker;
+    std::atomic<bool> cancelled;
+    std::atomic<size_t> loadedBytes;
+    std::atomic<size_t> totalBytes;
+    bool running;
+    std::function<void()> notify;
+
+    std::mutex mutex;
+    Update pending;
+};
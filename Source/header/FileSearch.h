@@ -0,0 +1,124 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Regex.h"
+
+// Find in Files: searches every file under a directory on a pool of worker threads, one
+// per core. Directories and files are tasks in per-worker deques; a worker lists a
+// directory into its own deque and takes its newest task first, so it goes depth-first
+// and reaches files quickly, while idle workers steal the oldest tasks of the others,
+// which are the biggest subtrees. Files are memory-mapped and searched where they lie.
+// Files with a NUL byte near the start are taken to be binary and skipped, as are files
+// over the size limit and hidden directories (.git and the like).
+//
+// Results go to the UI through a lock-free list: workers push each file's matches as
+// soon as it is done and the UI thread takes everything at once in Poll().
+class FileSearch {
+public:
+    // Bytes checked for a NUL to tell binary files.
+    static constexpr size_t BinaryProbe = 8 * 1024;
+    // Longest preview kept of a matching line; longer lines are cut around the match.
+    static constexpr size_t MaxPreview = 200;
+    static constexpr size_t PreviewContext = 40;
+    // Matching lines listed in all; the rest are still counted.
+    static constexpr size_t MaxListed = 1000000;
+
+    // A matching line. Matches after the first on a line only add to the file's count.
+    struct Line {
+        size_t line = 0;            // zero-based
+        size_t column = 0;          // byte column of the first match
+        std::string preview;
+        bool clipped = false;       // preview starts after the start of the line
+    };
+
+    struct FileResult {
+        std::string path;
+        size_t matches = 0;
+        std::vector<Line> lines;
+    };
+
+    struct Options {
+        std::string root;
+        std::string query;
+        bool regex = false;
+        size_t maxFileBytes = 64 * 1024 * 1024;
+        unsigned threads = 0;       // 0: one per core
+    };
+
+    FileSearch() : incoming(nullptr), cancelled(false), outstanding(0), active(0), finished(false), running(false),
+        filesSearched(0), filesSkipped(0), bytesSearched(0), matchCount(0), listed(0) {}
+    ~FileSearch() { Cancel(); }
+    FileSearch(const FileSearch&) = delete;
+    FileSearch& operator=(const FileSearch&) = delete;
+
+    // Cancels any search in progress and starts a new one. Returns false with a message in
+    // error when the query is empty or doesn't compile, or root can't be searched.
+    bool Start(const Options& options, std::string& error);
+    void Cancel();
+    // Called on a worker thread whenever results arrive or the search ends, so an idle UI
+    // can wake up. Set it while no search is running.
+    void SetNotify(std::function<void()> callback) { notify = std::move(callback); }
+
+    // Appends the files with matches found since the last call, in the order they were
+    // finished. Returns true when something arrived or the search ended.
+    bool Poll(std::vector<FileResult>& results);
+
+    bool Busy() const { return running; }
+    size_t FilesSearched() const { return filesSearched; }
+    size_t FilesSkipped() const { return filesSkipped; }
+    size_t BytesSearched() const { return bytesSearched; }
+    size_t MatchCount() const { return matchCount; }
+
+private:
+    struct Task {
+        std::string path;
+        bool directory = false;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    struct Node {
+        FileResult result;
+        Node* next;
+    };
+
+    void Run(size_t worker);
+    void Push(size_t worker, Task task);
+    bool Take(size_t worker, Task& task);
+    void List(size_t worker, const std::string& path);
+    void Search(const std::string& path, Regex* regex);
+    void Deliver(FileResult result);
+    void Notify() { if (notify) notify(); }
+
+    Options options;
+    Regex pattern;      // compiled once; each worker searches with its own copy
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<Node*> incoming;    // newest first
+
+    std::atomic<bool> cancelled;
+    std::atomic<size_t> outstanding;    // tasks queued or being worked on
+    std::atomic<size_t> active;         // workers still running
+    std::atomic<bool> finished;
+    std::mutex idleMutex;
+    std::condition_variable idle;       // workers wait here when there is nothing to steal
+    bool running;
+    std::function<void()> notify;
+
+    std::atomic<size_t> filesSearched;
+    std::atomic<size_t> filesSkipped;
+    std::atomic<size_t> bytesSearched;
+    std::atomic<size_t> matchCount;
+    std::atomic<size_t> listed;
+};
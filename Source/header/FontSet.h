@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+#include <imgui.h>
+
+// The UI font baked at a few sizes into one atlas. Text at a size in between is drawn
+// with the next larger size scaled down, so zooming never rebuilds or re-uploads the
+// atlas and takes effect on the next frame.
+//
+// The font is compiled into the executable. The rasterized atlas is cached in the
+// user's cache directory, keyed by everything it depends on, so later launches restore
+// it from disk without rasterizing anything.
+class FontSet {
+public:
+    static constexpr float MinSize = 8.0f;
+    static constexpr float MaxSize = 48.0f;
+    // Size used by menus, dialogs and the status bar.
+    static constexpr float UiSize = 20.0f;
+
+    FontSet() : fromCache(false), loadMs(0.0) {}
+
+    // Fills an empty atlas with every size and builds it, from the disk cache if possible.
+    void Load(ImFontAtlas* atlas);
+
+    // Font baked at the smallest size not below size; draw it with a font scale of
+    // size / font->FontSize.
+    ImFont* ForSize(float size) const;
+    ImFont* Ui() const { return ForSize(UiSize); }
+
+    bool LoadedFromCache() const { return fromCache; }
+    double LoadMs() const { return loadMs; }
+
+private:
+    bool Restore(ImFontAtlas* atlas, const std::filesystem::path& path, uint64_t key);
+    void Save(ImFontAtlas* atlas, const std::filesystem::path& path, uint64_t key) const;
+
+    std::vector<ImFont*> fonts;     // in increasing size
+    bool fromCache;
+    double loadMs;
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+
+// Decides when the main loop renders. After input the loop renders a few frames at the
+// display rate so ImGui's animations and hover states settle; after that it blocks until
+// input, a Wake() from any thread, or the editor's next deadline, instead of redrawing an
+// unchanged screen every vsync.
+class FramePacer {
+public:
+    static constexpr int SettleFrames = 3;
+
+    FramePacer() : settle(SettleFrames), skipped(0), refreshRate(60) {}
+
+    // Returns once the next frame should be rendered. timeout is how long the screen can
+    // stay as it is, in seconds: 0 renders right away, negative waits for input only.
+    void WaitForFrame(double timeout);
+    // Wakes up a waiting WaitForFrame. Safe to call from any thread.
+    static void Wake();
+
+    // Display refresh rate, used to count the frames that idling skipped.
+    void SetRefreshRate(int hz) { if (hz > 0) refreshRate = hz; }
+    size_t SkippedFrames() const { return skipped; }
+
+private:
+    int settle;         // frames still to render before idling
+    size_t skipped;
+    int refreshRate;
+};
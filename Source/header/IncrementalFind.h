@@ -0,0 +1,87 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "PieceTable.h"
+
+// Counts the matches of the find text as it is typed, on a worker thread over a snapshot
+// of the document, so a keystroke never waits for a scan; the count so far can be shown
+// while it runs. (The view finds the matches it shows on its own, a screenful at a time.)
+//
+// A finished literal count keeps where every occurrence starts, overlapping ones included,
+// and counts are kept for each query that led to the current one. When the query grows,
+// only the occurrences of the last one are checked for the added bytes, since every
+// occurrence of the longer text is one of them; when it shrinks back, the count for the
+// shorter query is still there. Edits drop them all. Regular expressions are recounted
+// from scratch.
+class IncrementalFind {
+public:
+    // Occurrences kept across all cached queries; past this the longest lists are dropped
+    // and the next keystroke rescans.
+    static constexpr size_t MaxOccurrences = 4 * 1024 * 1024;
+    // Checking an occurrence costs about as much as scanning this many bytes; when the
+    // last query's occurrences are denser than that, the longer one is scanned for.
+    static constexpr size_t BytesPerCheck = 128;
+    // Bytes a literal count scans between checks for Cancel(); a regular expression checks
+    // at every span it reads.
+    static constexpr size_t ScanWindow = 4 * 1024 * 1024;
+
+    IncrementalFind() : generation(0), stale(false), regex(false), complete(true), count(0), cachedOccurrences(0),
+        running(false), cancelled(false), found(0), ready(false) {}
+    ~IncrementalFind() { Cancel(); }
+    IncrementalFind(const IncrementalFind&) = delete;
+    IncrementalFind& operator=(const IncrementalFind&) = delete;
+
+    // Follows the find text: adopts a finished count and starts counting when the query,
+    // or the text, changed. Call once per frame while the find bar is open and the
+    // document isn't loading. An empty query (or invalid pattern) has no matches.
+    void Poll(const PieceTable& document, const std::string& query, bool isRegex);
+    void Cancel();
+    // Called on the worker thread when a count finishes, so an idle UI can wake up.
+    void SetNotify(std::function<void()> callback) { notify = std::move(callback); }
+    bool Busy() const { return running; }
+
+    // The document was edited: whatever was counted may have moved.
+    void TextChanged() { stale = true; }
+
+    // Matches Find Next steps through, so they don't overlap. While Busy() this is the
+    // number found so far.
+    size_t Count() const { return complete ? count : found.load(std::memory_order_relaxed); }
+    bool Complete() const { return complete; }
+
+private:
+    // Count for one literal query; occurrences is null when there were too many to keep.
+    struct Entry {
+        std::string query;
+        size_t count = 0;
+        std::shared_ptr<const std::vector<size_t>> occurrences;
+    };
+
+    void Start(const PieceTable& document, std::shared_ptr<const Entry> base);
+    void Run(PieceTable::Snapshot snapshot, std::string pattern, bool isRegex, std::shared_ptr<const Entry> base);
+    void Adopt(Entry entry);
+
+    size_t generation;      // of the document the cache was counted in
+    bool stale;             // edits since then
+    std::string query;      // being counted, or counted
+    bool regex;
+    bool complete;
+    size_t count;
+    // Counts for query and for shorter queries it starts with, shortest first.
+    std::vector<std::shared_ptr<const Entry>> cache;
+    size_t cachedOccurrences;
+
+    std::thread worker;
+    bool running;
+    std::atomic<bool> cancelled;
+    std::atomic<size_t> found;
+    std::function<void()> notify;
+    std::mutex mutex;
+    bool ready;
+    Entry result;
+};
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <imgui.h>
+
+// Glyph positions of one line of text at one font size. Built once per distinct line
+// and reused for drawing, hit-testing and cursor placement until the text changes.
+struct LineLayout {
+    struct Glyph {
+        float x;                    // left edge, from the start of the line
+        uint32_t offset;            // byte offset of the character in the line
+        const ImFontGlyph* glyph;   // nullptr for characters that draw nothing
+    };
+
+    std::vector<Glyph> glyphs;      // in text order, so x and offset both increase
+    size_t bytes = 0;
+    float width = 0.0f;
+    float scale = 1.0f;             // font size over the size the atlas was baked at
+
+    // x of the character at byte column, or the line's width past its end.
+    float XAt(size_t column) const;
+    // Byte column whose character boundary is nearest to x.
+    size_t ColumnAt(float x) const;
+    // Emits the glyphs in [begin, end) that overlap [clipLeft, clipRight) with the line
+    // placed at pos.
+    void Draw(ImDrawList* drawList, const ImVec2& pos, float clipLeft, float clipRight, ImU32 color,
+        size_t begin = 0, size_t end = SIZE_MAX) const;
+    // Index of the first glyph of each visual row when the line is word-wrapped to width;
+    // always starts with 0. text is the string the layout was built from.
+    std::vector<uint32_t> Wrap(const std::string& text, float width) const;
+};
+
+// LRU cache of line layouts keyed by the line's content, font and font size, so a frame
+// only lays out lines that changed since they were last on screen. Identical lines share
+// one layout wherever they are in the document.
+class LayoutCache {
+public:
+    static constexpr size_t DefaultBudget = 16 * 1024 * 1024;
+
+    LayoutCache() : memoryUsed(0), budget(DefaultBudget), hits(0), misses(0) {}
+
+    // Layout of text, from the cache or built now. It stays valid while it is held, even
+    // if the cache evicts it. Glyphs point into the font, so call Clear() when the font
+    // atlas is rebuilt.
+    std::shared_ptr<const LineLayout> Get(const std::string& text, ImFont* font, float fontSize);
+    // Lays out text without caching it.
+    static std::shared_ptr<LineLayout> Build(const std::string& text, ImFont* font, float fontSize);
+
+    void Clear();
+    void SetBudget(size_t bytes) { budget = bytes; Trim(); }
+
+    size_t Hits() const { return hits; }
+    size_t Misses() const { return misses; }
+    void ResetCounters() { hits = misses = 0; }
+    size_t Lines() const { return entries.size(); }
+    size_t MemoryUsed() const { return memoryUsed; }
+
+private:
+    struct Entry {
+        uint64_t key;
+        std::string text;       // kept to tell hash collisions apart
+        ImFont* font;
+        float fontSize;
+        std::shared_ptr<const LineLayout> layout;
+        size_t cost;
+    };
+    using EntryList = std::list<Entry>;
+
+    static uint64_t Key(const std::string& text, ImFont* font, float fontSize);
+    void Remove(EntryList::iterator entry);
+    void Trim();
+
+    EntryList entries;      // most recently used first
+    std::unordered_map<uint64_t, EntryList::iterator> index;
+    size_t memoryUsed;
+    size_t budget;
+    size_t hits;
+    size_t misses;
+};
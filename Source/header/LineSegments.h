@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Horizontal index of one very long line, cut into segments of about SegmentBytes that
+// are laid out separately. A Fenwick tree over the segments' widths turns an x position
+// into a segment and back in O(log n). Segments that haven't been laid out yet count
+// with an estimated width until SetWidth() measures them, so only the segments that
+// come into view are ever read. When the view wraps, each segment wraps on its own and a
+// second tree over their row counts does the same for rows.
+class LineSegments {
+public:
+    static constexpr size_t SegmentBytes = 4096;
+
+    LineSegments() : start(0), length(0), total(0.0), rowWidth(0.0f), totalRows(0) {}
+
+    // A line of length bytes at document offset lineStart, every segment estimated at
+    // estimate pixels.
+    void Reset(size_t lineStart, size_t lineLength, double estimate);
+    void SetWidth(size_t segment, double width);
+
+    size_t Start() const { return start; }
+    size_t Length() const { return length; }
+    size_t Count() const { return widths.size(); }
+    bool Measured(size_t segment) const { return measured[segment]; }
+    // Left edge of a segment, from the start of the line.
+    double XOf(size_t segment) const;
+    // Segment covering x, clamped to the first and last.
+    size_t SegmentAt(double x) const;
+    double Width() const { return total; }
+
+    // Every segment estimated at estimate rows when wrapped at width.
+    void ResetRows(float width, size_t estimate);
+    void SetRows(size_t segment, size_t count);
+    // Width the rows are counted at; 0 until ResetRows().
+    float RowWidth() const { return rowWidth; }
+    // First row of a segment, and the segment holding a row (clamped to the last) with
+    // the row's index within it.
+    uint64_t RowOf(size_t segment) const;
+    size_t SegmentAtRow(uint64_t row, size_t& rowInSegment) const;
+    uint64_t TotalRows() const { return totalRows; }
+
+private:
+    size_t start;
+    size_t length;
+    std::vector<double> widths;
+    std::vector<bool> measured;
+    std::vector<double> tree;   // Fenwick tree of widths, 1-based
+    double total;
+    float rowWidth;
+    std::vector<uint32_t> rows;
+    std::vector<uint64_t> rowTree;  // Fenwick tree of row counts, 1-based
+    uint64_t totalRows;
+};
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// Read-only bytes of a file. Regular files are memory-mapped, so opening costs no
+// copy and no anonymous memory; pipes, devices and files the OS refuses to map are
+// read into a heap buffer instead. The mapping assumes nobody truncates the file
+// while it is open.
+class MappedFile {
+public:
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Reading falls back to the heap for at most maxReadBytes; larger inputs fail.
+    static std::unique_ptr<MappedFile> Open(const std::string& path, size_t maxReadBytes, std::string& error);
+    static std::unique_ptr<MappedFile> FromMemory(std::string text);
+
+    const char* Data() const { return data; }
+    size_t Size() const { return size; }
+    bool IsMapped() const { return mapped; }
+
+private:
+    MappedFile() : data(nullptr), size(0), mapped(false), mapping(nullptr) {}
+    bool Map(const std::string& path, std::string& error);
+    bool Read(const std::string& path, size_t maxReadBytes, std::string& error);
+
+    const char* data;
+    size_t size;
+    bool mapped;
+    void* mapping;       // platform mapping handle (Windows section handle)
+    std::string heap;    // owns the bytes when not mapped
+};
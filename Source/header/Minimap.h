@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <imgui.h>
+#include "PieceTable.h"
+
+// Overview of the whole document drawn from a small density texture: one texel row per
+// run of lines, one texel column per CharsPerTexel characters, with alpha for how much of
+// it isn't blank. The texture is built from a snapshot of the document on a worker thread
+// and patched on the UI thread as lines are edited, so a frame costs one quad however big
+// the document is. The minimap holds no GPU state; the caller uploads Pixels().
+//
+// A build gives each row linesPerRow lines; after that every row keeps count of its own,
+// so lines added or removed by an edit go in or out of the row the edit is in and the
+// rows after it stay as they are. The next build evens them out again; one is only
+// started once the line count calls for another linesPerRow, or a row holds more than
+// twice that many lines or, unless it is the last, less than half.
+class Minimap {
+public:
+    static constexpr int Columns = 64;
+    static constexpr int MaxRows = 2048;
+    static constexpr size_t CharsPerTexel = 2;
+    // Short documents aren't stretched: a line is at most this many pixels tall.
+    static constexpr float MaxLineHeight = 3.0f;
+
+    Minimap() : linesPerRow(1), dirtyFirst(0), dirtyEnd(0), generation(0), stale(true), patching(false), editRow(0),
+        touchedFirst(0), touchedEnd(0), running(false), cancelled(false), ready(false) {}
+    ~Minimap() { Cancel(); }
+    Minimap(const Minimap&) = delete;
+    Minimap& operator=(const Minimap&) = delete;
+
+    // Adopts a finished build, and starts a new one when the document was replaced or
+    // edits left the rows to be laid out again. Call once per frame while the document isn't
+    // loading. Returns true when a build was adopted.
+    bool Poll(const PieceTable& document);
+    void Cancel();
+    // Called on the worker thread when a build finishes, so an idle UI can wake up.
+    void SetNotify(std::function<void()> callback) { notify = std::move(callback); }
+    bool Busy() const { return running; }
+
+    // Bracket an edit that replaces lines [line, line + lines) with the lines passed to
+    // AfterEdit: the old lines are taken out of their rows and the new ones put in the row
+    // the first of them was in.
+    void BeforeEdit(const PieceTable& document, size_t line, size_t lines);
+    void AfterEdit(const PieceTable& document, size_t line, size_t lines);
+
+    // RGBA texels, Columns wide and Rows() high: white, with density as alpha.
+    const uint32_t* Pixels() const { return pixels.data(); }
+    int Rows() const { return (int)(pixels.size() / Columns); }
+    // Rows changed since the last call, as [first, end). False when nothing changed.
+    bool TakeDirty(int& first, int& end);
+
+    // Draws the map into size at the cursor position with the visible lines marked.
+    // Returns true with the line to scroll to while it is clicked or dragged.
+    bool Render(const char* id, ImTextureID texture, const ImVec2& size, size_t topLine, size_t visibleLines,
+        size_t lineCount, size_t& scrollTo);
+
+private:
+    // Texel counts of one build: non-blank characters per texel, and lines per row.
+    struct Counts {
+        std::vector<uint32_t> texels;
+        std::vector<uint32_t> lines;
+        size_t linesPerRow = 1;
+    };
+
+    // Edits touching more lines than this aren't patched; the next build picks them up.
+    static constexpr size_t MaxPatchLines = 1024;
+    // Only the start of a line reaches the last texel column, tabs and UTF-8 included.
+    static constexpr size_t MaxScanBytes = Columns * CharsPerTexel * 4;
+
+    // Counts the characters of a span of one line into row, continuing from column.
+    static void CountSpan(const char* data, size_t length, size_t& column, uint32_t* row, int sign);
+    static Counts Layout(size_t lineCount);
+    void Start(const PieceTable& document);
+    void Run(PieceTable::Snapshot snapshot);
+    // Row line is in by the rows' own line counts, with the line the row starts at; the
+    // last row for lines past the end.
+    size_t RowOf(size_t line, size_t& rowStart) const;
+    void CountLine(const PieceTable& document, size_t line, size_t row, int sign);
+    // Whether row's line count is far enough from linesPerRow to be worth a build.
+    bool Uneven(size_t row) const;
+    void UpdatePixels(size_t first, size_t end);
+
+    std::vector<uint32_t> texels;
+    std::vector<uint32_t> rowLines;
+    std::vector<uint32_t> pixels;
+    size_t linesPerRow;     // of the last build
+    size_t dirtyFirst;
+    size_t dirtyEnd;
+    size_t generation;      // of the document the last build was started from
+    bool stale;             // the rows are to be laid out again
+    bool patching;          // BeforeEdit took lines out of their rows
+    size_t editRow;         // row the new lines go in
+    size_t touchedFirst;    // rows patched by the edit, as [first, end)
+    size_t touchedEnd;
+
+    std::thread worker;
+    bool running;
+    std::atomic<bool> cancelled;
+    std::function<void()> notify;
+    std::mutex mutex;
+    bool ready;
+    Counts result;
+};
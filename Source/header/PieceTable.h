@@ -0,0 +1,140 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "MappedFile.h"
+#include "Rope.h"
+
+// Piece-table document: the text is described by a list of pieces that point
+// either into the read-only original buffer or into the append-only add buffer.
+// Edits only split/insert pieces, so their cost depends on the edit, not the file.
+// The pieces live in a Rope, which also answers line/column queries in O(log n).
+//
+// The original buffer is the opened file itself (memory-mapped when possible) and the
+// add buffer grows in blocks that never move, so pieces refer to their bytes by pointer.
+// All sizes are size_t; on 64-bit builds documents are limited only by the memory budget.
+class PieceTable {
+public:
+    static constexpr size_t Unlimited = (size_t)-1;
+
+    PieceTable() : addUsed(0), addCapacity(0), memoryUsed(0), memoryBudget(Unlimited), generation(0) {}
+
+    void Load(std::string text);
+    bool LoadFile(const std::string& path, std::string& error);
+    // Writes the document atomically: a failed or interrupted save leaves path untouched.
+    bool SaveFile(const std::string& path, std::string& error);
+    void Clear() { Load(std::string()); }
+
+    // Progressive loading: BeginLoad starts an empty document backed by file and
+    // AppendLoaded adds the next pieces of it, in order, as they are indexed.
+    void BeginLoad(std::shared_ptr<const MappedFile> file);
+    void AppendLoaded(const std::vector<Piece>& pieces);
+
+    // Splits [data, data + length) into MaxChunk-sized pieces appended to out.
+    static void AppendChunked(std::vector<Piece>& out, const char* data, size_t length);
+
+    // Insert fails (and leaves the document untouched) when it would exceed the memory budget.
+    bool Insert(size_t pos, const char* text, size_t length);
+    bool Insert(size_t pos, const std::string& text) { return Insert(pos, text.data(), text.size()); }
+    void Erase(size_t pos, size_t length);
+    // Replaces each (start, length) range, sorted and disjoint, with text in one pass. The
+    // new pieces are built directly: long runs of kept text refer to the old bytes, short
+    // ones are copied along with the replacements. Fails, leaving the document untouched,
+    // when the copies would exceed the memory budget.
+    bool ReplaceRanges(const std::vector<std::pair<size_t, size_t>>& ranges, const char* text, size_t length);
+
+    // Pieces covering [pos, pos + length). They point into buffers that are never modified,
+    // so they can be kept (e.g. for undo) and inserted again until the next reload.
+    std::vector<Piece> PiecesIn(size_t pos, size_t length) const;
+    // Inserts pieces from PiecesIn without copying their bytes.
+    void InsertPieces(size_t pos, const std::vector<Piece>& pieces);
+    // Read-only copy of the text for another thread. Rope nodes are immutable and shared,
+    // and the snapshot holds on to the buffers its pieces point into, so the document can
+    // go on being edited, or even reloaded, while the copy is read.
+    struct Snapshot {
+        Rope pieces;
+        std::shared_ptr<const MappedFile> original;
+        std::vector<std::shared_ptr<char[]>> addBlocks;
+
+        size_t LineCount() const { return pieces.Newlines() + 1; }
+    };
+    Snapshot TakeSnapshot() const { return Snapshot{ rope, original, addBlocks }; }
+    // A document over a snapshot's text, so the usual queries and searches can run on the
+    // other thread. Edits to it go to add blocks of its own.
+    explicit PieceTable(Snapshot snapshot) : original(std::move(snapshot.original)),
+        addBlocks(std::move(snapshot.addBlocks)), addUsed(0), addCapacity(0), memoryUsed(0), memoryBudget(Unlimited),
+        rope(std::move(snapshot.pieces)), generation(0) {}
+
+    // Changes whenever the buffers are replaced (load, clear); pieces taken
+    // under an older generation are no longer valid.
+    size_t Generation() const { return generation; }
+
+    size_t Size() const { return rope.Size(); }
+    bool Empty() const { return rope.Size() == 0; }
+    size_t LineCount() const { return rope.Newlines() + 1; }
+    bool IsMapped() const { return original && original->IsMapped(); }
+
+    // Heap bytes held by the original and add buffers, checked against the budget.
+    // A memory-mapped original doesn't count.
+    size_t MemoryUsed() const { return memoryUsed; }
+    size_t MemoryBudget() const { return memoryBudget; }
+    void SetMemoryBudget(size_t bytes) { memoryBudget = bytes; }
+
+    // Copies [pos, pos + length) into out and returns the number of bytes copied.
+    size_t Read(size_t pos, size_t length, char* out) const;
+    std::string Read(size_t pos, size_t length) const;
+    std::string ToString() const { return Read(0, Size()); }
+    char At(size_t pos) const;
+
+    // Zero-based line and byte column of offset.
+    void LineColumn(size_t offset, size_t& line, size_t& column) const;
+    // Offset of the first byte of a zero-based line, clamped to the last line.
+    size_t LineStart(size_t line) const;
+    size_t LineEnd(size_t line) const;
+
+    // Calls fn(const char* data, size_t length) for every contiguous span in
+    // [pos, pos + length), in document order. Returning false from fn stops the walk.
+    template <typename Fn>
+    void ForEachSpan(size_t pos, size_t length, Fn&& fn) const {
+        if (pos >= Size() || length == 0) return;
+        size_t end = pos + std::min(length, Size() - pos);
+        Rope::Position start = rope.FindOffset(pos);
+        size_t pieceStart = start.offset;
+        rope.ForEachPiece(start.index, [&](const Piece& piece) {
+            size_t from = pos > pieceStart ? pos - pieceStart : 0;
+            size_t to = std::min(piece.length, end - pieceStart);
+            if (!fn(piece.data + from, to - from)) return false;
+            pieceStart += piece.length;
+            return pieceStart < end;
+        });
+    }
+
+    template <typename Fn>
+    void ForEachSpan(Fn&& fn) const { ForEachSpan(0, Size(), std::forward<Fn>(fn)); }
+
+    const Rope& Pieces() const { return rope; }
+
+private:
+    static constexpr size_t MinAddBlock = 64 * 1024;
+    static constexpr size_t MaxAddBlock = 64 * 1024 * 1024;
+
+    void Reset(std::shared_ptr<const MappedFile> file);
+    // Copies text to the end of the add buffer; nullptr when the budget is exhausted.
+    const char* Append(const char* text, size_t length);
+
+    Piece Slice(const Piece& piece, size_t from, size_t to) const;
+    void Compact(std::vector<Piece>& run);
+
+    // Shared with a background loader that may still be indexing it.
+    std::shared_ptr<const MappedFile> original;
+    std::vector<std::shared_ptr<char[]>> addBlocks;    // shared with snapshots
+    size_t addUsed;
+    size_t addCapacity;
+    size_t memoryUsed;
+    size_t memoryBudget;
+    Rope rope;
+    size_t generation;
+};
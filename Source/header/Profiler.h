@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Scoped timers for finding where frame time goes, in the field and without a profiler
+// attached. Put PROFILE_SCOPE("Name") at the top of a block; the time until the end of
+// the block is added to that scope's total for the frame. While profiling is off a scope
+// costs one relaxed atomic load, and building with TEXTEDITOR_NO_PROFILER compiles the
+// scopes out. Scopes may run on any thread; frames are closed on the UI thread.
+class Profiler {
+public:
+    static constexpr int MaxScopes = 64;
+    static constexpr int HistoryFrames = 240;
+
+    static bool Enabled() { return enabled.load(std::memory_order_relaxed); }
+    static void SetEnabled(bool on) { enabled.store(on, std::memory_order_relaxed); }
+
+    // Index of the scope called name (a string literal), added on first use; -1 when all
+    // MaxScopes are taken. Scopes with the same name share one entry.
+    static int Register(const char* name);
+    static void Add(int scope, int64_t nanoseconds);
+
+    // Bracket the work of one frame, leaving out the time spent waiting for input.
+    // EndFrame moves every scope's total into its history.
+    static void BeginFrame();
+    static void EndFrame();
+
+    // Frame-time graph and p50/p99/max per scope over the last HistoryFrames frames.
+    static void RenderOverlay(bool* open);
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+class ProfileScope {
+public:
+    explicit ProfileScope(int scope) : scope(scope >= 0 && Profiler::Enabled() ? scope : -1) {
+        if (this->scope >= 0) start = std::chrono::steady_clock::now();
+    }
+    ~ProfileScope() {
+        if (scope >= 0)
+            Profiler::Add(scope, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    int scope;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#ifdef TEXTEDITOR_NO_PROFILER
+#define PROFILE_SCOPE(name) ((void)0)
+#else
+#define PROFILE_SCOPE(name) \
+    static const int PROFILE_CONCAT(profileScopeId, __LINE__) = Profiler::Register(name); \
+    ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(PROFILE_CONCAT(profileScopeId, __LINE__))
+#endif
@@ -0,0 +1,141 @@
+#pragma once
+#include <atomic>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "PieceTable.h"
+
+// Regular expressions for searching documents, matched byte by byte. The pattern compiles
+// to Thompson NFAs, forwards and backwards, which a search runs as DFAs whose states are
+// built lazily, as the text needs them, in a cache of at most MaxCacheBytes: forwards to
+// where the first match ends, then backwards from there to where it starts. A full cache
+// is cleared and refilled; when that keeps happening the search finishes by simulating
+// the NFA instead. If every match starts with the same literal, the DFA skips ahead to
+// its occurrences with TextKernels::FindSubstring. The document is read span by span,
+// never copied.
+//
+// Syntax: literals, ., [...] and [^...], \d \w \s and their negations, \t \n \r \f \v
+// \xHH, (...) and (?:...), |, * + ? {n} {n,} {n,m} (a trailing ? is accepted but makes no
+// difference), ^ and $ at line boundaries, and (?i) at the very start for ASCII case
+// insensitivity. Matches are leftmost-longest and, as in grep, never span lines.
+//
+// A Regex keeps its DFA cache between searches, so it isn't safe to share across threads;
+// give each thread a copy. Another thread can still stop a long search through the flag
+// given to SetCancel.
+class Regex {
+public:
+    static constexpr size_t MaxCacheBytes = 2 * 1024 * 1024;
+
+    Regex() : start(0), reverseStart(0), classCount(0), dead(-1), cacheBytes(0), markGeneration(0), cancel(nullptr),
+        statesBuilt(0), cacheClears(0), nfaFallbacks(0) {}
+
+    // Replaces the pattern. Returns false with a message in error if it doesn't parse,
+    // leaving the regex empty.
+    bool Compile(const std::string& pattern, std::string& error);
+    bool Empty() const { return states.empty(); }
+    const std::string& Pattern() const { return pattern; }
+    // Bytes every match starts with; used to skip ahead.
+    const std::string& Prefix() const { return prefix; }
+
+    // Leftmost-longest match lying within [from, to). Returns false when there is none.
+    bool Find(const PieceTable& document, size_t from, size_t to, size_t& matchStart, size_t& matchEnd);
+    // Once *flag is set, searches stop at the next span they read and find nothing. Null,
+    // the default, never stops them.
+    void SetCancel(const std::atomic<bool>* flag) { cancel = flag; }
+
+    // Totals over all searches, for benchmarks: DFA states built, cache clears, and
+    // searches finished by the NFA.
+    size_t StatesBuilt() const { return statesBuilt; }
+    size_t CacheClears() const { return cacheClears; }
+    size_t NfaFallbacks() const { return nfaFallbacks; }
+
+private:
+    struct Node;
+    struct Fragment;
+    class Parser;
+
+    enum class Kind : uint8_t { Byte, Split, Empty, LineStart, LineEnd, Match };
+    struct State {
+        Kind kind;
+        int out;
+        int out1;                   // second branch of a Split
+        std::bitset<256> bytes;     // what a Byte state consumes
+    };
+
+    // A DFA state: NFA states about to be expanded, whether a line starts here, and
+    // whether new matches may no longer start.
+    struct DState {
+        std::vector<int> kernel;
+        bool lineStart;
+        bool anchored;
+    };
+
+    // NFAs beyond this many states a direction are rejected, e.g. from large nested
+    // counted repeats.
+    static constexpr size_t MaxStates = 20000;
+    // Cache clears tolerated per search before giving up on the DFA, if each one was
+    // reached after fewer than ThrashBytesPerState bytes per state built.
+    static constexpr size_t MaxClears = 3;
+    static constexpr size_t ThrashBytesPerState = 10;
+
+    int AddState(Kind kind, int out = -1, int out1 = -1);
+    Fragment CompileNode(const Node& node, bool reverse);
+    void Patch(const Fragment& fragment, int target);
+    void BuildByteClasses();
+
+    void Closure(const std::vector<int>& kernel, bool lineStart, bool lineEnd, std::vector<int>& out);
+    void ClearCache();
+    // Index of the DFA state, added if new; -1 when the cache is full.
+    int AddDState(const std::vector<int>& nfaStates, bool lineStart, bool anchored);
+    // Transition of DFA state s on byte class cls, encoded as where the next state's row
+    // of transitions starts * 2 + (a match ends before the byte); -1 when the cache is full.
+    int Transition(int s, int cls);
+    bool MatchesAtEnd(int s, bool lineEnd);
+    bool Cancelled() const { return cancel && cancel->load(std::memory_order_relaxed); }
+    // Steps DFA state s over [from, to), backwards if asked, until it is dead. last is set
+    // wherever a match ends in the direction of travel. False when the cache is full.
+    bool Run(const PieceTable& document, int& s, size_t from, size_t to, bool backward, size_t& last);
+    // The leftmost-longest match within [begin, to), knowing that begin is on the line
+    // where the first match ends, at end. False when the DFAs can't tell.
+    bool Bounds(const PieceTable& document, size_t begin, bool lineStartAtBegin, size_t end, size_t to,
+        bool lineEndAtTo, size_t& matchStart, size_t& matchEnd);
+
+    // Leftmost-longest match within [begin, limit) by simulating the NFA.
+    bool SimulateNfa(const PieceTable& document, size_t begin, size_t limit, bool lineEndAtLimit,
+        size_t& matchStart, size_t& matchEnd);
+
+    std::string pattern;
+    std::string prefix;
+    std::vector<State> states;
+    int start;
+    int reverseStart;
+
+    // Bytes no state tells apart share a class, which keeps DFA rows short.
+    uint8_t classOf[256];
+    uint8_t classByte[256];     // a byte of each class
+    int classCount;
+
+    std::vector<DState> dstates;
+    std::vector<int> transitions;   // classCount per DFA state, -1 until computed
+    std::unordered_map<std::string, int> dindex;
+    int startStates[2];             // by lineStart
+    int anchoredStarts[2];          // the same, starting no further matches
+    int reverseStarts[2];           // of the backwards NFA, by whether a line ends here
+    int dead;                       // the state with nothing left to match, or -1
+    size_t cacheBytes;
+
+    std::vector<uint32_t> marks;    // closure visits, by NFA state
+    uint32_t markGeneration;
+    std::vector<int> stack;
+    std::vector<int> closure;
+    std::vector<int> kernel;
+
+    const std::atomic<bool>* cancel;
+
+    size_t statesBuilt;
+    size_t cacheClears;
+    size_t nfaFallbacks;
+};
@@ -0,0 +1,95 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// A span of one of the document's buffers, at most Rope::MaxChunk bytes long.
+struct Piece {
+    const char* data;
+    size_t length;
+    size_t newlines;
+};
+
+// B-tree rope over the pieces of a document. Every node caches the byte, newline and
+// piece counts of its subtree, so offset and line lookups are O(log n). Nodes are
+// immutable and shared: an edit copies only the path it touches.
+class Rope {
+public:
+    static constexpr size_t MaxChunk = 4096;
+    static constexpr size_t MinChunk = 1024;
+
+    // A piece together with where it sits in the document.
+    struct Position {
+        size_t index;      // piece index, PieceCount() past the end
+        size_t offset;     // document offset of the piece's first byte
+        size_t newlines;   // newlines before the piece
+        Piece piece;
+    };
+
+    size_t Size() const { return root ? root->bytes : 0; }
+    size_t Newlines() const { return root ? root->newlines : 0; }
+    size_t PieceCount() const { return root ? root->pieces : 0; }
+
+    void Assign(const std::vector<Piece>& pieces);
+    void Clear() { root.reset(); }
+
+    // Replaces removeCount pieces starting at index with count new pieces.
+    void Splice(size_t index, size_t removeCount, const Piece* pieces, size_t count);
+
+    Piece PieceAt(size_t index) const;
+
+    // Piece containing the byte at offset.
+    Position FindOffset(size_t offset) const;
+    // Piece containing the nth newline of the document (1-based).
+    Position FindNewline(size_t n) const;
+
+    // Calls fn(const Piece&) for pieces from index onwards until it returns false.
+    template <typename Fn>
+    void ForEachPiece(size_t index, Fn&& fn) const {
+        if (root) Walk(*root, index, fn);
+    }
+
+private:
+    static constexpr size_t MaxEntries = 32;
+    static constexpr size_t MinEntries = 8;
+
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+    using NodeList = std::vector<NodePtr>;
+
+    struct Node {
+        bool leaf = true;
+        size_t bytes = 0;
+        size_t newlines = 0;
+        size_t pieces = 0;
+        std::vector<Piece> items;
+        NodeList children;
+
+        size_t Entries() const { return leaf ? items.size() : children.size(); }
+    };
+
+    static NodePtr MakeLeaf(std::vector<Piece> items);
+    static NodePtr MakeInternal(NodeList children);
+    static NodeList SplitLeaves(std::vector<Piece> items);
+    static NodeList SplitInternal(NodeList children);
+    static void Rebalance(NodeList& nodes, size_t from, size_t to);
+    static NodeList SpliceNode(const NodePtr& node, size_t index, size_t removeCount, const Piece* pieces, size_t count);
+    static NodePtr BuildUp(NodeList level);
+
+    // Returns false once fn has asked to stop.
+    template <typename Fn>
+    static bool Walk(const Node& node, size_t& skip, Fn& fn) {
+        if (skip >= node.pieces) { skip -= node.pieces; return true; }
+        if (node.leaf) {
+            for (size_t i = skip; i < node.items.size(); i++)
+                if (!fn(node.items[i])) return false;
+            skip = 0;
+            return true;
+        }
+        for (const NodePtr& child : node.children)
+            if (!Walk(*child, skip, fn)) return false;
+        return true;
+    }
+
+    NodePtr root;
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+
+// Byte-scanning kernels used for statistics and line lookups. Each has a portable
+// scalar version plus SSE2, AVX2 and AVX-512BW versions on x86; the best one the CPU
+// and OS support is picked at startup via CPUID.
+namespace TextKernels {
+
+enum class Isa { Scalar, SSE2, AVX2, AVX512 };
+
+Isa DetectedIsa();
+Isa ActiveIsa();
+// Switches to isa, clamped to what the CPU supports (for benchmarks).
+void SetIsa(Isa isa);
+const char* IsaName(Isa isa);
+
+size_t CountNewlines(const char* data, size_t length);
+
+// Counts word starts: non-space bytes (C-locale isspace) preceded by a space. inWord
+// says whether the byte before data was part of a word and is updated for the next call.
+size_t CountWordStarts(const char* data, size_t length, bool& inWord);
+
+// Index of the nth newline (1-based) in data, or length when there are fewer than n.
+size_t FindNthNewline(const char* data, size_t length, size_t n);
+
+// Index of the first occurrence of needle in data, or length when there is none. Needles
+// up to LongNeedle bytes are found by comparing their first and last bytes against a
+// vector of positions at once and checking only the candidates that pass; longer ones use
+// Two-Way, which is linear in the worst case and skips ahead on mismatches.
+constexpr size_t LongNeedle = 32;
+size_t FindSubstring(const char* data, size_t length, const char* needle, size_t needleLength);
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <string>
+#include "PieceTable.h"
+#include "Regex.h"
+
+// Literal search over a document without flattening it. Each span is searched where it
+// lies with TextKernels::FindSubstring; only the last needle-length bytes before a piece
+// boundary are copied, to find the matches that straddle it. Matches don't overlap: the
+// search resumes after the end of each one.
+namespace TextSearch {
+
+constexpr size_t NotFound = (size_t)-1;
+
+// Calls fn(offset) for each match lying entirely within [pos, pos + length), in order,
+// until fn returns false.
+void ForEachMatch(const PieceTable& document, const std::string& needle, size_t pos, size_t length,
+    const std::function<bool(size_t)>& fn);
+// The same, but overlapping matches are all reported: the search resumes a byte after
+// the start of each one.
+void ForEachOccurrence(const PieceTable& document, const std::string& needle, size_t pos, size_t length,
+    const std::function<bool(size_t)>& fn);
+
+// First match starting at or after from, or NotFound.
+size_t FindNext(const PieceTable& document, const std::string& needle, size_t from);
+// Last occurrence starting before before, overlapping ones included, or NotFound. Searched
+// backwards a window at a time, so a match near the cursor is found without scanning from
+// the start of the document.
+size_t FindPrevious(const PieceTable& document, const std::string& needle, size_t before);
+
+// The same with a regular expression; fn and length also get each match's length, which
+// may be 0. After an empty match the search resumes a byte further on.
+void ForEachMatch(const PieceTable& document, Regex& regex, size_t pos, size_t length,
+    const std::function<bool(size_t, size_t)>& fn);
+size_t FindNext(const PieceTable& document, Regex& regex, size_t from, size_t& length);
+// Windows start at line starts, so matches are the ones a search from there finds.
+size_t FindPrevious(const PieceTable& document, Regex& regex, size_t before, size_t& length);
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include "Rope.h"
+
+// Undo/redo stack of edit deltas. Each step records where an edit happened and the
+// pieces it removed and inserted; the pieces point into the document's immutable
+// buffers, so a step costs memory per piece, not per byte, and undoing it is a splice.
+// Consecutive keystrokes are merged into one step until the run is closed.
+class UndoHistory {
+public:
+    static constexpr size_t DefaultBudget = 64 * 1024 * 1024;
+
+    struct Step {
+        size_t offset;
+        std::vector<Piece> removed;
+        std::vector<Piece> inserted;
+        size_t removedBytes;
+        size_t insertedBytes;
+    };
+
+    UndoHistory() : applied(0), savedAt(0), merging(false), memoryUsed(0), budget(DefaultBudget) {}
+
+    // Records that [offset, offset + removed bytes) was replaced by inserted. Typing
+    // edits extend the previous step when they continue it; a newline ends the run.
+    void Record(size_t offset, std::vector<Piece> removed, std::vector<Piece> inserted, bool typing);
+    // Ends the current typing run, so the next edit starts a new step.
+    void Close() { merging = false; }
+
+    // Step to revert or reapply, or nullptr. The caller applies it to the document.
+    const Step* Undo();
+    const Step* Redo();
+    bool CanUndo() const { return applied > 0; }
+    bool CanRedo() const { return applied < steps.size(); }
+
+    void Clear();
+    // Remembers the current state as the one on disk.
+    void MarkSaved() { savedAt = applied; merging = false; }
+    bool AtSavePoint() const { return savedAt == applied; }
+
+    // Oldest steps are dropped once the recorded steps exceed the budget.
+    size_t MemoryUsed() const { return memoryUsed; }
+    void SetBudget(size_t bytes) { budget = bytes; Trim(); }
+
+private:
+    static constexpr size_t NoSavePoint = (size_t)-1;
+
+    static size_t Cost(const Step& step);
+    static void AppendPieces(std::vector<Piece>& to, const std::vector<Piece>& pieces);
+    bool Merge(Step& step, size_t offset, const std::vector<Piece>& removed, size_t removedBytes,
+        const std::vector<Piece>& inserted, size_t insertedBytes);
+    void Trim();
+
+    std::deque<Step> steps;
+    size_t applied;     // steps[0, applied) are in the document; the rest can be redone
+    size_t savedAt;     // value of applied when last saved, or NoSavePoint
+    bool merging;
+    size_t memoryUsed;
+    size_t budget;
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Number of visual rows each line wraps into at one width, kept in a B-tree over the
+// lines like Rope's over pieces: every node caches the line, row and unmeasured counts of
+// its subtree, so the first row of a line, the line at a row, and an edit that adds or
+// removes lines are all O(log n). Lines that haven't been laid out at the current width
+// carry an estimate until SetRows() measures them.
+class WrapIndex {
+public:
+    WrapIndex() : width(0.0f) {}
+
+    // Every line unmeasured, counted as one row.
+    void Reset(size_t lineCount, float width);
+    // Switches to a new width. Measured counts are scaled by the change as estimates, so
+    // the scroll position and scrollbar stay roughly where they were.
+    void Rescale(float width);
+    // Lines [line, line + removed) were replaced by inserted lines, all unmeasured. Lines
+    // appended while a file loads are a replacement of the last line.
+    void Replace(size_t line, size_t removed, size_t inserted);
+    void SetRows(size_t line, size_t count);
+
+    size_t Rows(size_t line) const { return Entry(line) & CountMask; }
+    // Visual row the line starts on.
+    uint64_t RowOf(size_t line) const;
+    // Line containing a visual row, and the row's index within that line.
+    size_t LineAtRow(uint64_t row, size_t& rowInLine) const;
+    uint64_t TotalRows() const { return root ? root->rows : 0; }
+
+    size_t LineCount() const { return root ? root->lines : 0; }
+    float Width() const { return width; }
+    size_t Unmeasured() const { return root ? root->unmeasured : 0; }
+    // First unmeasured line at or after from, wrapping around to the start; LineCount()
+    // when every line is measured.
+    size_t NextUnmeasured(size_t from) const;
+
+private:
+    static constexpr size_t MaxLeafLines = 256;
+    static constexpr size_t MinLeafLines = 64;
+    static constexpr size_t MaxEntries = 32;
+    static constexpr size_t MinEntries = 8;
+    static constexpr uint32_t Measured = 0x80000000u;
+    static constexpr uint32_t CountMask = 0x7FFFFFFFu;
+
+    struct Node;
+    using NodePtr = std::unique_ptr<Node>;
+    using NodeList = std::vector<NodePtr>;
+
+    // Unlike Rope's, nodes are owned by one tree and changed in place: SetRows is called
+    // for every line measured, and copying a path each time would dominate.
+    struct Node {
+        bool leaf = true;
+        size_t lines = 0;
+        uint64_t rows = 0;
+        size_t unmeasured = 0;
+        std::vector<uint32_t> items;    // per line: row count, plus Measured once laid out
+        NodeList children;
+
+        size_t Entries() const { return leaf ? items.size() : children.size(); }
+        bool Small() const { return Entries() < (leaf ? MinLeafLines : MinEntries); }
+    };
+
+    static NodePtr MakeLeaf(std::vector<uint32_t> items);
+    static NodePtr MakeInternal(NodeList children);
+    static NodeList SplitLeaves(std::vector<uint32_t> items);
+    static NodeList SplitInternal(NodeList children);
+    static void Rebalance(NodeList& nodes, size_t from, size_t to);
+    static NodeList SpliceNode(NodePtr node, size_t line, size_t removed, size_t inserted);
+    static NodePtr BuildUp(NodeList level);
+    static void Scale(Node& node, double scale);
+    static size_t FindUnmeasured(const Node& node, size_t from);
+
+    uint32_t Entry(size_t line) const;
+    // Replaces the entry of a line, keeping the counts of the nodes above it.
+    void Update(size_t line, uint32_t entry);
+
+    NodePtr root;
+    float width;
+};
@@ -3,42 +3,154 @@
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 #include <tinyfiledialogs.h>
+#include <PieceTable.h>
+#include <EditorView.h>
+#include <Minimap.h>
+#include <FileLoader.h>
+#include <FontSet.h>
+#include <FramePacer.h>
+#include <Profiler.h>
+#include <UndoHistory.h>
+#include <TextKernels.h>
+#include <TextSearch.h>
+#include <IncrementalFind.h>
+#include <FileSearch.h>
+#include <Regex.h>
+#include <Benchmark.h>
 #include <iostream>
+#include <chrono>
 #include <fstream>
-#include <sstream>
 #include <string>
 #include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <climits>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <vector>
+#include <cstdint>
+
+// Windows' gl.h stops at OpenGL 1.1.
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
 
 class TextEditor {
 private:
-    char* textBuffer;
-    size_t bufferSize;
+    PieceTable document;
+
+    // Files are opened and indexed in the background; the document is read-only until done.
+    FileLoader loader;
+    bool loading;
+    std::chrono::steady_clock::time_point loadStarted;
+    double firstPaintMs;
+    std::string loadReport;
+
+    // Edit history of the current document; cleared when the document's buffers are replaced.
+    UndoHistory history;
+    size_t historyGeneration;
+
+    // Draws the document directly; edits come back through ReplaceRange.
+    EditorView view;
+    // Overview beside the view. Its texture is created on first use and released with
+    // the GL context.
+    Minimap minimap;
+    GLuint minimapTexture;
+    int minimapTextureRows;
+    bool showMinimap;
+    // No GL context (headless runs): the minimap is drawn without its texture.
+    bool headless;
     std::string currentFilePath;
     bool hasUnsavedChanges;
     float fontSize;
     bool showMenu;
+    bool showGoToLine;
+    bool showDebugOverlay;
+    bool showProfiler;
+    int goToLine;
+    // Find bar: the text is highlighted in the view while the bar is open. As a regular
+    // expression it is compiled into findPattern when it changes.
+    bool showFind;
+    bool focusFind;
+    char findText[256];
+    char replaceText[256];
+    bool findRegex;
+    Regex findPattern;
+    std::string findError;
+    std::string findStatus;
+    // Matches of the find text in the whole document, counted in the background.
+    IncrementalFind findCount;
+    // Find in Files panel. Results arrive from fileSearch file by file; searchRows lists
+    // them as one row per file followed by its lines, for a clipped list.
+    bool showFindInFiles;
+    char searchText[256];
+    char searchRoot[512];
+    bool searchRegex;
+    int searchMaxMiB;
+    FileSearch fileSearch;
+    std::vector<FileSearch::FileResult> searchResults;
+    std::vector<std::pair<size_t, size_t>> searchRows;    // (result, line), NoLine for the file
+    std::string searchError;
+    // Where to put the cursor once the file opened from a search result has loaded.
+    bool pendingGoTo;
+    size_t pendingLine;
+    size_t pendingColumn;
 
     std::string clipboardText;
 
-    int currentLine;
-    int currentColumn;
-    int wordCount;
-    int charCount;
+    size_t currentLine;
+    size_t currentColumn;
+    size_t wordCount;
+    size_t charCount;
+
+    // Cursor offset the status bar was last computed for.
+    size_t lastCursor;
+    // Set when the cursor moved or the text changed; idle frames skip the line lookup.
+    bool cursorDirty;
+    // Frames the main loop didn't render while idle, shown in the status bar.
+    size_t skippedFrames;
+    std::string startupReport;
 
 public:
-    TextEditor() : bufferSize(1024 * 1024), hasUnsavedChanges(false), fontSize(20.0f), showMenu(false),
-        currentLine(1), currentColumn(1), wordCount(0), charCount(0) {
-        textBuffer = new char[bufferSize];
-        textBuffer[0] = '\0';
+    TextEditor() : loading(false), firstPaintMs(-1), historyGeneration(0), minimapTexture(0), minimapTextureRows(0),
+        showMinimap(true), headless(false), hasUnsavedChanges(false), fontSize(FontSet::UiSize), showMenu(false),
+        showGoToLine(false), showDebugOverlay(false), showProfiler(false), goToLine(1), showFind(false),
+        focusFind(false), findText(), replaceText(), findRegex(false), showFindInFiles(false),
+        searchText(), searchRoot(), searchRegex(false), searchMaxMiB(64), pendingGoTo(false), pendingLine(0), pendingColumn(0),
+        currentLine(1), currentColumn(1), wordCount(0), charCount(0),
+        lastCursor(0), cursorDirty(true), skippedFrames(0) {
+        loader.SetNotify(FramePacer::Wake);
+        minimap.SetNotify(FramePacer::Wake);
+        findCount.SetNotify(FramePacer::Wake);
+        fileSearch.SetNotify(FramePacer::Wake);
     }
 
-    ~TextEditor() {
-        delete[] textBuffer;
+    void SetMemoryBudget(size_t bytes) { document.SetMemoryBudget(bytes); }
+    void SetUndoBudget(size_t bytes) { history.SetBudget(bytes); }
+    void SetSkippedFrames(size_t frames) { skippedFrames = frames; }
+    void SetStartupReport(const std::string& report) { startupReport = report; }
+    void SetHeadless(bool enabled) { headless = enabled; }
+
+    // How long the screen can stay as it is without input, in seconds: 0 while a mouse
+    // button is held (drag selection autoscrolls) or wrapping is still being measured,
+    // -1 when only input can change it.
+    double IdleTimeout() const {
+        if (ImGui::IsAnyMouseDown() || view.Reflowing()) return 0.0;
+        double timeout = view.BlinkTimeout();
+        // Batches wake the loop as they arrive; this only keeps the progress text moving.
+        if (loader.Busy() && (timeout < 0.0 || timeout > 0.1)) timeout = 0.1;
+        // The same for the match count while it is still going up.
+        if (findCount.Busy() && (timeout < 0.0 || timeout > 0.1)) timeout = 0.1;
+        if (fileSearch.Busy() && (timeout < 0.0 || timeout > 0.1)) timeout = 0.1;
+        return timeout;
     }
 
     void NewFile() {
         if (hasUnsavedChanges && ConfirmSave()) SaveFile();
-        textBuffer[0] = '\0';
+        CancelLoad();
+        document.Clear();
+        view.Reset();
         currentFilePath.clear();
         hasUnsavedChanges = false;
         UpdateStats();
@@ -54,94 +166,561 @@ public:
 
         const char* filter[1] = { "*.txt" };
         const char* path = tinyfd_openFileDialog("Open File", "", 1, filter, "Text Files", 0);
-        if (path) {
-            std::ifstream file(path);
-            if (file) {
-                std::stringstream buf;
-                buf << file.rdbuf();
-                std::string content = buf.str();
-                if (content.length() < bufferSize - 1) {
-                    strcpy(textBuffer, content.c_str());
-                    currentFilePath = path;
-                    hasUnsavedChanges = false;
-                    UpdateStats();
-                }
-                else {
-                    tinyfd_messageBox("Error", "File too large!", "ok", "error", 1);
-                }
+        if (path) Open(path);
+    }
+
+    // Starts loading path in the background in place of the current document.
+    void Open(const std::string& path) {
+        CancelLoad();
+        pendingGoTo = false;
+        loader.Start(path, document.MemoryBudget());
+        loadStarted = std::chrono::steady_clock::now();
+        firstPaintMs = -1;
+        loadReport.clear();
+    }
+    bool Loading() const { return loader.Busy(); }
+
+    // Appends whatever the loader has indexed since the last frame. The statistics grow with
+    // it, and the start of the file is on screen after the first batch.
+    void PollLoader() {
+        FileLoader::Update update;
+        if (!loader.Poll(update)) return;
+        if (update.file) {
+            document.BeginLoad(update.file);
+            view.Reset();
+            currentFilePath = update.path;
+            hasUnsavedChanges = false;
+            wordCount = charCount = 0;
+            loading = true;
+        }
+        for (const FileLoader::Batch& batch : update.batches) {
+            size_t lastLine = document.LineCount() - 1;
+            document.AppendLoaded(batch.pieces);
+            view.TextChanged(lastLine, 0, document.LineCount() - 1 - lastLine);
+            wordCount += batch.wordStarts;
+            charCount = document.Size();
+            cursorDirty = true;
+            if (firstPaintMs < 0) firstPaintMs = ElapsedMs(loadStarted);
+        }
+        if (update.finished) {
+            loading = false;
+            bool goTo = pendingGoTo;
+            pendingGoTo = false;
+            if (!update.error.empty()) {
+                tinyfd_messageBox("Error", update.error.c_str(), "ok", "error", 1);
+                return;
             }
+            double totalMs = ElapsedMs(loadStarted);
+            if (firstPaintMs < 0) firstPaintMs = totalMs;
+            char report[96];
+            snprintf(report, sizeof(report), "Opened in %.0f ms, first paint %.0f ms", totalMs, firstPaintMs);
+            loadReport = report;
+            if (goTo) GoToLineColumn(pendingLine, pendingColumn);
         }
     }
 
+    // Stops a load in progress; a partially loaded document is discarded rather than left
+    // around where it could be saved over the original.
+    void CancelLoad() {
+        if (!loader.Busy()) return;
+        loader.Cancel();
+        if (loading) {
+            loading = false;
+            pendingGoTo = false;
+            document.Clear();
+            view.Reset();
+            currentFilePath.clear();
+            hasUnsavedChanges = false;
+            UpdateStats();
+            loadReport = "Loading cancelled";
+        }
+    }
+
+    static double ElapsedMs(std::chrono::steady_clock::time_point since) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+    }
+
     void SaveFile() {
+        if (loading) return;
         if (currentFilePath.empty()) SaveAsFile();
-        else {
-            std::ofstream file(currentFilePath);
-            if (file) {
-                file << textBuffer;
-                hasUnsavedChanges = false;
-            }
-        }
+        else if (WriteDocument(currentFilePath)) hasUnsavedChanges = false;
     }
 
     void SaveAsFile() {
+        if (loading) return;
         const char* filter[1] = { "*.txt" };
         const char* path = tinyfd_saveFileDialog("Save File As", "untitled.txt", 1, filter, "Text Files");
-        if (path) {
-            std::ofstream file(path);
-            if (file) {
-                file << textBuffer;
-                currentFilePath = path;
-                hasUnsavedChanges = false;
-            }
+        if (path && WriteDocument(path)) {
+            currentFilePath = path;
+            hasUnsavedChanges = false;
         }
     }
 
+    bool WriteDocument(const std::string& path) {
+        std::string error;
+        if (document.SaveFile(path, error)) {
+            SyncHistory();
+            history.MarkSaved();
+            return true;
+        }
+        tinyfd_messageBox("Error", error.c_str(), "ok", "error", 1);
+        return false;
+    }
+
     void CopyText() {
-        clipboardText = std::string(textBuffer);
+        clipboardText = document.ToString();
         glfwSetClipboardString(nullptr, clipboardText.c_str());
     }
 
     void CutText() {
+        if (loading) return;
         CopyText();
-        textBuffer[0] = '\0';
-        hasUnsavedChanges = true;
-        UpdateStats();
+        ReplaceRange(0, document.Size(), std::string(), false);
     }
 
     void PasteText() {
         const char* clip = glfwGetClipboardString(nullptr);
-        if (clip && strlen(textBuffer) + strlen(clip) < bufferSize - 1) {
-            strcat(textBuffer, clip);
-            hasUnsavedChanges = true;
-            UpdateStats();
+        if (!clip || loading) return;
+        ReplaceRange(document.Size(), 0, clip, false);
+    }
+
+    void ReportBudgetExceeded() {
+        tinyfd_messageBox("Error", "The edit would exceed the document memory budget.", "ok", "error", 1);
+    }
+
+    void ZoomIn() { fontSize = std::min(fontSize + 2.0f, FontSet::MaxSize); }
+    void ZoomOut() { fontSize = std::max(fontSize - 2.0f, FontSet::MinSize); }
+
+    // Replaces [start, start + removed) with text.
+    bool ReplaceRange(size_t start, size_t removed, const std::string& text, bool typing) {
+        if (loading || (removed == 0 && text.empty())) return false;
+        return Edit(start, removed, text.size(), typing, [&] {
+            // Insert before erasing so a budget failure leaves the document untouched.
+            if (!document.Insert(start + removed, text.data(), text.size())) return false;
+            document.Erase(start, removed);
+            return true;
+        });
+    }
+
+    // Runs apply, which turns [start, start + removed) into inserted bytes or fails without
+    // changing the document. Every edit goes through here, so the history, the statistics
+    // and the modified flag stay in step with the document.
+    bool Edit(size_t start, size_t removed, size_t inserted, bool typing, const std::function<bool()>& apply) {
+        size_t wordsBefore = WordStartsAround(start, removed);
+        std::vector<Piece> removedPieces = document.PiecesIn(start, removed);
+        size_t line = LineOf(start);
+        size_t removedLines = LineOf(start + removed) - line;
+        minimap.BeforeEdit(document, line, removedLines + 1);
+        if (!apply()) {
+            minimap.AfterEdit(document, line, removedLines + 1);
+            ReportBudgetExceeded();
+            return false;
+        }
+        size_t insertedLines = LineOf(start + inserted) - line;
+        view.TextChanged(line, removedLines, insertedLines);
+        minimap.AfterEdit(document, line, insertedLines + 1);
+        findCount.TextChanged();
+        SyncHistory();
+        history.Record(start, std::move(removedPieces), document.PiecesIn(start, inserted), typing);
+        AdjustStats(start, wordsBefore, inserted);
+        hasUnsavedChanges = true;
+        cursorDirty = true;
+        return true;
+    }
+
+    // Replaces every match of the find text with the replace text in one pass over the
+    // document, as a single step of the history.
+    void ReplaceAll() {
+        if (loading || !findText[0]) return;
+        if (findRegex && !CompileFind()) {
+            findStatus = findError;
+            return;
+        }
+        std::vector<std::pair<size_t, size_t>> ranges;
+        size_t matched = 0;
+        auto add = [&](size_t match, size_t length) {
+            ranges.emplace_back(match, length);
+            matched += length;
+            return true;
+        };
+        if (findRegex) {
+            TextSearch::ForEachMatch(document, findPattern, 0, document.Size(), add);
+        }
+        else {
+            std::string needle = findText;
+            TextSearch::ForEachMatch(document, needle, 0, document.Size(), [&](size_t match) { return add(match, needle.size()); });
+        }
+        if (ranges.empty()) {
+            findStatus = "Not found";
+            return;
         }
+        std::string replacement = replaceText;
+        size_t start = ranges.front().first;
+        size_t removed = ranges.back().first + ranges.back().second - start;
+        size_t inserted = removed - matched + ranges.size() * replacement.size();
+        if (!Edit(start, removed, inserted, false, [&] { return document.ReplaceRanges(ranges, replacement.data(), replacement.size()); }))
+            return;
+        view.SetCursor(start + inserted);
+        findStatus = "Replaced " + std::to_string(ranges.size());
+    }
+
+    size_t LineOf(size_t offset) const {
+        size_t line, column;
+        document.LineColumn(offset, line, column);
+        return line;
     }
 
-    void ZoomIn() { fontSize = std::min(fontSize + 2.0f, 48.0f); }
-    void ZoomOut() { fontSize = std::max(fontSize - 2.0f, 8.0f); }
+    // History steps hold pieces of the document's buffers, so they go when the buffers do.
+    void SyncHistory() {
+        if (historyGeneration == document.Generation()) return;
+        history.Clear();
+        historyGeneration = document.Generation();
+    }
+
+    // Reverts or reapplies one history step. Both are a splice of recorded pieces, so the
+    // cost depends on the size of the edit, not of the document.
+    void ApplyHistory(int direction) {
+        if (loading) return;
+        SyncHistory();
+        const UndoHistory::Step* step = direction < 0 ? history.Undo() : history.Redo();
+        if (!step) return;
+        size_t start = step->offset;
+        size_t oldLength = direction < 0 ? step->insertedBytes : step->removedBytes;
+        size_t newLength = direction < 0 ? step->removedBytes : step->insertedBytes;
+        size_t wordsBefore = WordStartsAround(start, oldLength);
+        size_t line = LineOf(start);
+        size_t removedLines = LineOf(start + oldLength) - line;
+        minimap.BeforeEdit(document, line, removedLines + 1);
+        document.Erase(start, oldLength);
+        document.InsertPieces(start, direction < 0 ? step->removed : step->inserted);
+        size_t insertedLines = LineOf(start + newLength) - line;
+        view.TextChanged(line, removedLines, insertedLines);
+        minimap.AfterEdit(document, line, insertedLines + 1);
+        findCount.TextChanged();
+        AdjustStats(start, wordsBefore, newLength);
+        hasUnsavedChanges = !history.AtSavePoint();
+        view.SetCursor(start + newLength);
+        cursorDirty = true;
+    }
 
+    // Full recount, used on open/new and from the menu; edits go through AdjustStats.
     void UpdateStats() {
-        charCount = strlen(textBuffer);
+        PROFILE_SCOPE("UpdateStats");
+        charCount = document.Size();
         wordCount = 0; bool inWord = false;
-        for (int i = 0; i < charCount; i++) {
-            if (isspace(textBuffer[i])) inWord = false;
-            else if (!inWord) { inWord = true; wordCount++; }
-        }
+        document.ForEachSpan([&](const char* data, size_t length) {
+            wordCount += TextKernels::CountWordStarts(data, length, inWord);
+            return true;
+        });
+    }
+
+    // Word starts (non-space bytes after a space or the start of the text) in [from, to).
+    size_t CountWordStarts(size_t from, size_t to) const {
+        size_t count = 0;
+        bool inWord = from > 0 && !isspace((unsigned char)document.At(from - 1));
+        document.ForEachSpan(from, to - from, [&](const char* data, size_t length) {
+            count += TextKernels::CountWordStarts(data, length, inWord);
+            return true;
+        });
+        return count;
+    }
+
+    // Word starts an edit of [start, start + length) can change: the span itself plus the
+    // byte after it, whose start-of-word status depends on the span's last byte.
+    size_t WordStartsAround(size_t start, size_t length) const {
+        return CountWordStarts(start, std::min(start + length + 1, document.Size()));
+    }
+
+    // Applies the word-count delta of an edit that replaced the bytes counted by
+    // wordsBefore with inserted bytes at start.
+    void AdjustStats(size_t start, size_t wordsBefore, size_t inserted) {
+        wordCount = wordCount - wordsBefore + WordStartsAround(start, inserted);
+        charCount = document.Size();
     }
 
     void UpdateCursorPosition() {
-        currentLine = 1; currentColumn = 1;
-        for (int i = 0; i < charCount; i++) {
-            if (textBuffer[i] == '\n') { currentLine++; currentColumn = 1; }
-            else currentColumn++;
+        PROFILE_SCOPE("UpdateCursorPosition");
+        cursorDirty = false;
+        size_t line, column;
+        lastCursor = view.Cursor();
+        document.LineColumn(lastCursor, line, column);
+        currentLine = line + 1;
+        currentColumn = column + 1;
+    }
+
+    void GoToLine(int line) {
+        line = std::max(1, std::min(line, (int)document.LineCount()));
+        view.SetCursor(document.LineStart(line - 1));
+        view.Focus();
+    }
+
+    // Zero-based line and byte column, clamped to the end of the line.
+    void GoToLineColumn(size_t line, size_t column) {
+        size_t start = document.LineStart(line);
+        view.SetCursor(std::min(start + column, document.LineEnd(line)));
+        view.Focus();
+    }
+
+    // Opens the find bar, starting from the selection when it is a short piece of one line.
+    void OpenFind() {
+        size_t start = view.SelectionStart(), length = view.SelectionEnd() - start;
+        if (length > 0 && length < sizeof(findText)) {
+            std::string selected = document.Read(start, length);
+            if (selected.find('\n') == std::string::npos) snprintf(findText, sizeof(findText), "%s", selected.c_str());
+        }
+        showFind = true;
+        focusFind = true;
+        findStatus.clear();
+    }
+
+    // Compiles the find text if it changed since the last time. Returns false when it
+    // isn't a valid regular expression, with the reason in findError.
+    bool CompileFind() {
+        if (findPattern.Pattern() != findText) {
+            findError.clear();
+            findPattern.Compile(findText, findError);
+        }
+        return findError.empty();
+    }
+
+    // Selects the next (direction > 0) or previous match of the find text, from the
+    // selection and wrapping around the document once.
+    void FindNext(int direction) {
+        std::string needle = findText;
+        if (needle.empty()) return;
+        if (findRegex && !CompileFind()) {
+            findStatus = findError;
+            return;
+        }
+        size_t found, length = needle.size();
+        if (findRegex && direction > 0) {
+            size_t from = view.SelectionEnd();
+            found = TextSearch::FindNext(document, findPattern, from, length);
+            // Step over an empty match at the cursor rather than finding it again.
+            if (found == from && length == 0 && !view.HasSelection())
+                found = from < document.Size() ? TextSearch::FindNext(document, findPattern, from + 1, length) : TextSearch::NotFound;
+            if (found == TextSearch::NotFound) found = TextSearch::FindNext(document, findPattern, 0, length);
+        }
+        else if (findRegex) {
+            found = TextSearch::FindPrevious(document, findPattern, view.SelectionStart(), length);
+            if (found == TextSearch::NotFound) found = TextSearch::FindPrevious(document, findPattern, document.Size(), length);
+        }
+        else if (direction > 0) {
+            found = TextSearch::FindNext(document, needle, view.SelectionEnd());
+            if (found == TextSearch::NotFound) found = TextSearch::FindNext(document, needle, 0);
+        }
+        else {
+            found = TextSearch::FindPrevious(document, needle, view.SelectionStart());
+            if (found == TextSearch::NotFound) found = TextSearch::FindPrevious(document, needle, document.Size());
+        }
+        if (found == TextSearch::NotFound) {
+            findStatus = "Not found";
+            return;
+        }
+        findStatus.clear();
+        view.Select(found, found + length);
+    }
+
+    // 1234567 as "1,234,567".
+    static std::string GroupThousands(size_t value) {
+        std::string digits = std::to_string(value);
+        for (size_t i = digits.size(); i > 3; i -= 3) digits.insert(i - 3, ",");
+        return digits;
+    }
+
+    void RenderFind() {
+        ImGuiIO& io = ImGui::GetIO();
+        ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x - 460, 100), ImGuiCond_Appearing);
+        ImGui::Begin("Find", &showFind, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoSavedSettings);
+        if (focusFind) {
+            ImGui::SetKeyboardFocusHere();
+            focusFind = false;
+        }
+        ImGui::SetNextItemWidth(220);
+        bool submitted = ImGui::InputText("##find", findText, sizeof(findText), ImGuiInputTextFlags_EnterReturnsTrue);
+        if (ImGui::IsItemEdited()) findStatus.clear();
+        // Enter leaves the field; take it back so Enter keeps stepping through matches.
+        if (submitted) focusFind = true;
+        ImGui::SameLine();
+        if (ImGui::Button("Previous") || (submitted && io.KeyShift)) FindNext(-1);
+        ImGui::SameLine();
+        if (ImGui::Button("Next") || (submitted && !io.KeyShift)) FindNext(1);
+        ImGui::SameLine();
+        if (ImGui::Checkbox("Regex", &findRegex)) findStatus.clear();
+        if (findRegex && findText[0] && !CompileFind()) findStatus = findError;
+        ImGui::SetNextItemWidth(220);
+        ImGui::InputText("##replace", replaceText, sizeof(replaceText));
+        ImGui::SameLine();
+        if (ImGui::Button("Replace All")) ReplaceAll();
+        if (!findStatus.empty()) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("%s", findStatus.c_str());
+        }
+        else if (findText[0]) {
+            // "1,234+" while the count is still running.
+            size_t count = findCount.Count();
+            ImGui::SameLine();
+            ImGui::TextDisabled("%s%s %s", GroupThousands(count).c_str(), findCount.Complete() ? "" : "+",
+                count == 1 && findCount.Complete() ? "match" : "matches");
+        }
+        ImGui::End();
+    }
+
+    static constexpr size_t NoLine = (size_t)-1;
+
+    // Opens the Find in Files panel with the find text and the open file's folder, unless
+    // it already has its own.
+    void OpenFindInFiles() {
+        if (!searchText[0]) snprintf(searchText, sizeof(searchText), "%s", findText);
+        if (!searchRoot[0]) {
+            std::string folder = currentFilePath.substr(0, currentFilePath.find_last_of("/\\") + 1);
+            snprintf(searchRoot, sizeof(searchRoot), "%s", folder.empty() ? "." : folder.c_str());
+        }
+        showFindInFiles = true;
+    }
+
+    void StartFileSearch() {
+        FileSearch::Options options;
+        options.root = searchRoot;
+        options.query = searchText;
+        options.regex = searchRegex;
+        options.maxFileBytes = (size_t)std::max(searchMaxMiB, 1) << 20;
+        searchResults.clear();
+        searchRows.clear();
+        searchError.clear();
+        fileSearch.Start(options, searchError);
+    }
+
+    // Adds the files that arrived since the last frame to the list.
+    void PollFileSearch() {
+        size_t first = searchResults.size();
+        if (!fileSearch.Poll(searchResults)) return;
+        for (size_t i = first; i < searchResults.size(); i++) {
+            searchRows.emplace_back(i, NoLine);
+            for (size_t line = 0; line < searchResults[i].lines.size(); line++) searchRows.emplace_back(i, line);
+        }
+    }
+
+    // Moves to a result, opening its file first unless it is the one already open.
+    void OpenResult(const std::string& path, const FileSearch::Line& line) {
+        if (path == currentFilePath && !loading) {
+            GoToLineColumn(line.line, line.column);
+            return;
+        }
+        if (hasUnsavedChanges && ConfirmSave()) SaveFile();
+        Open(path);
+        pendingGoTo = true;
+        pendingLine = line.line;
+        pendingColumn = line.column;
+    }
+
+    void RenderFindInFiles() {
+        ImGuiIO& io = ImGui::GetIO();
+        ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x * 0.5f - 360, 120), ImGuiCond_Appearing);
+        ImGui::SetNextWindowSize(ImVec2(720, 480), ImGuiCond_Appearing);
+        ImGui::Begin("Find in Files", &showFindInFiles, ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoSavedSettings);
+        if (ImGui::IsWindowAppearing()) ImGui::SetKeyboardFocusHere();
+        ImGui::SetNextItemWidth(320);
+        bool submitted = ImGui::InputText("##search", searchText, sizeof(searchText), ImGuiInputTextFlags_EnterReturnsTrue);
+        ImGui::SameLine();
+        ImGui::Checkbox("Regex##search", &searchRegex);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(80);
+        ImGui::InputInt("Max MiB", &searchMaxMiB, 0, 0);
+        ImGui::SetNextItemWidth(440);
+        submitted |= ImGui::InputText("##folder", searchRoot, sizeof(searchRoot), ImGuiInputTextFlags_EnterReturnsTrue);
+        ImGui::SameLine();
+        if (ImGui::Button("Browse...")) {
+            const char* folder = tinyfd_selectFolderDialog("Find in Files", searchRoot);
+            if (folder) snprintf(searchRoot, sizeof(searchRoot), "%s", folder);
+        }
+        ImGui::SameLine();
+        bool busy = fileSearch.Busy();
+        if (ImGui::Button(busy ? "Stop" : "Search")) {
+            if (busy) fileSearch.Cancel();
+            else submitted = true;
+        }
+        if (submitted) StartFileSearch();
+
+        if (!searchError.empty()) {
+            ImGui::TextDisabled("%s", searchError.c_str());
+        }
+        else if (busy || !searchResults.empty() || fileSearch.FilesSearched() > 0) {
+            ImGui::TextDisabled("%s matches in %s files | %s files searched (%.0f MiB), %s skipped%s",
+                GroupThousands(fileSearch.MatchCount()).c_str(), GroupThousands(searchResults.size()).c_str(),
+                GroupThousands(fileSearch.FilesSearched()).c_str(), fileSearch.BytesSearched() / (1024.0 * 1024.0),
+                GroupThousands(fileSearch.FilesSkipped()).c_str(), fileSearch.Busy() ? " | Searching..." : "");
         }
+
+        // Only the rows in view are submitted, however many results there are.
+        ImGui::BeginChild("##results", ImVec2(0, 0), true);
+        ImGuiListClipper clipper;
+        clipper.Begin((int)searchRows.size());
+        while (clipper.Step()) {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                const FileSearch::FileResult& result = searchResults[searchRows[row].first];
+                size_t index = searchRows[row].second;
+                if (index == NoLine) {
+                    ImGui::Text("%s (%zu)", result.path.c_str(), result.matches);
+                    continue;
+                }
+                const FileSearch::Line& line = result.lines[index];
+                ImGui::PushID(row);
+                if (ImGui::Selectable("##result")) OpenResult(result.path, line);
+                ImGui::SameLine();
+                ImGui::Text("%8zu: %s%s", line.line + 1, line.clipped ? "..." : "", line.preview.c_str());
+                ImGui::PopID();
+            }
+        }
+        ImGui::EndChild();
+        ImGui::End();
     }
 
-    void Render(ImFont* font) {
+    static constexpr float MinimapWidth = 80.0f;
+
+    // Copies the rows the minimap changed into its texture.
+    void UpdateMinimapTexture() {
+        int first, end;
+        if (!minimap.TakeDirty(first, end)) return;
+        if (!minimapTexture) {
+            glGenTextures(1, &minimapTexture);
+            glBindTexture(GL_TEXTURE_2D, minimapTexture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        glBindTexture(GL_TEXTURE_2D, minimapTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        if (minimap.Rows() != minimapTextureRows) {
+            minimapTextureRows = minimap.Rows();
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, Minimap::Columns, minimapTextureRows, 0, GL_RGBA, GL_UNSIGNED_BYTE, minimap.Pixels());
+        }
+        else {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, Minimap::Columns, end - first, GL_RGBA, GL_UNSIGNED_BYTE,
+                minimap.Pixels() + (size_t)first * Minimap::Columns);
+        }
+    }
+
+    // Internal counters, for checking that caches are doing their job.
+    void RenderDebugOverlay() {
         ImGuiIO& io = ImGui::GetIO();
-        ImGui::PushFont(font);
+        ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x - 340, 110), ImGuiCond_FirstUseEver);
+        ImGui::SetNextWindowBgAlpha(0.85f);
+        ImGui::Begin("Debug", &showDebugOverlay, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing);
+        LayoutCache& layouts = view.Layouts();
+        size_t lookups = layouts.Hits() + layouts.Misses();
+        ImGui::Text("Layout cache: %zu lines, %.1f KiB", layouts.Lines(), layouts.MemoryUsed() / 1024.0);
+        ImGui::Text("Hits %zu, misses %zu (%.1f%%)", layouts.Hits(), layouts.Misses(),
+            lookups ? 100.0 * layouts.Hits() / lookups : 0.0);
+        if (ImGui::SmallButton("Reset counters")) layouts.ResetCounters();
+        if (!startupReport.empty()) ImGui::TextUnformatted(startupReport.c_str());
+        ImGui::End();
+    }
 
+    void RenderTitleBar() {
+        PROFILE_SCOPE("Title bar");
+        ImGuiIO& io = ImGui::GetIO();
         // Custom title bar
         ImGui::SetNextWindowPos(ImVec2(0, 0));
         ImGui::SetNextWindowSize(ImVec2(io.DisplaySize.x, 50));
@@ -156,7 +735,10 @@ public:
         ImGui::SameLine();
         if (ImGui::Button("X")) glfwSetWindowShouldClose(glfwGetCurrentContext(), GLFW_TRUE);
         ImGui::End();
+    }
 
+    void RenderMenu() {
+        PROFILE_SCOPE("Menu");
         // Menu Button properly aligned
         ImGui::SetNextWindowPos(ImVec2(0, 30));
         ImGui::SetNextWindowSize(ImVec2(50, 50));
@@ -197,63 +779,175 @@ public:
                 PasteText();
                 showMenu = false;
             }
+            if (ImGui::MenuItem("Undo", "Ctrl+Z", false, history.CanUndo() && !loading)) {
+                ApplyHistory(-1);
+                showMenu = false;
+            }
+            if (ImGui::MenuItem("Redo", "Ctrl+Y", false, history.CanRedo() && !loading)) {
+                ApplyHistory(1);
+                showMenu = false;
+            }
+            if (ImGui::MenuItem("Go to Line", "Ctrl+G")) {
+                showGoToLine = true;
+                showMenu = false;
+            }
+            if (ImGui::MenuItem("Find", "Ctrl+F")) {
+                OpenFind();
+                showMenu = false;
+            }
+            if (ImGui::MenuItem("Find Next", "F3", false, findText[0] != 0)) {
+                FindNext(1);
+                showMenu = false;
+            }
+            if (ImGui::MenuItem("Find Previous", "Shift+F3", false, findText[0] != 0)) {
+                FindNext(-1);
+                showMenu = false;
+            }
+            if (ImGui::MenuItem("Find in Files", "Ctrl+Shift+F")) {
+                OpenFindInFiles();
+                showMenu = false;
+            }
             ImGui::Separator();
+            bool wordWrap = view.Wrap();
+            if (ImGui::MenuItem("Word Wrap", nullptr, &wordWrap)) {
+                view.SetWrap(wordWrap);
+            }
             if (ImGui::MenuItem("Zoom In")) {
                 ZoomIn();
             }
             if (ImGui::MenuItem("Zoom Out")) {
                 ZoomOut();
             }
+            ImGui::Separator();
+            if (ImGui::MenuItem("Recount Words", nullptr, false, !loading)) {
+                UpdateStats();
+                showMenu = false;
+            }
+            ImGui::MenuItem("Minimap", nullptr, &showMinimap);
+            ImGui::MenuItem("Debug Overlay", nullptr, &showDebugOverlay);
+            ImGui::MenuItem("Profiler", nullptr, &showProfiler);
 
             ImGui::End();
         }
+    }
 
+    void RenderEditorWindow(const FontSet& fonts) {
+        PROFILE_SCOPE("Editor");
+        ImGuiIO& io = ImGui::GetIO();
         ImGui::SetNextWindowPos(ImVec2(10, 100));
         ImGui::SetNextWindowSize(ImVec2(io.DisplaySize.x - 20, io.DisplaySize.y - 160));
-        ImGui::Begin("Editor", nullptr, ImGuiWindowFlags_NoTitleBar);
-
-        ImGuiInputTextFlags flags = ImGuiInputTextFlags_AllowTabInput | ImGuiInputTextFlags_CallbackEdit;
-        if (ImGui::InputTextMultiline("##text", textBuffer, bufferSize,
-            ImVec2(io.DisplaySize.x - 40, io.DisplaySize.y - 200), flags,
-            [](ImGuiInputTextCallbackData* data) -> int {
-                TextEditor* ed = (TextEditor*)data->UserData;
-                ed->hasUnsavedChanges = true;
-                ed->UpdateStats();
-                return 0;
-            }, this)) {
-            showMenu = false;
-            hasUnsavedChanges = true;
-            UpdateStats();
+        ImGui::Begin("Editor", nullptr, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse);
+        // Zoom picks the nearest baked size and scales it; the atlas stays as it is.
+        ImGui::PushFont(fonts.ForSize(fontSize));
+        ImGui::SetWindowFontScale(fontSize / ImGui::GetFont()->FontSize);
+        ImVec2 editorSize(io.DisplaySize.x - 40, io.DisplaySize.y - 200);
+        if (showMinimap) editorSize.x -= MinimapWidth + ImGui::GetStyle().ItemSpacing.x;
+        view.Render("##text", document, editorSize, loading,
+            [this](size_t start, size_t removed, const std::string& text, bool typing) {
+                showMenu = false;
+                return ReplaceRange(start, removed, text, typing);
+            });
+        ImGui::SetWindowFontScale(1.0f);
+        ImGui::PopFont();
+        if (showMinimap) {
+            // Built once the whole file is in, rather than again for every batch.
+            if (!loading) minimap.Poll(document);
+            if (!headless) UpdateMinimapTexture();
+            ImGui::SameLine();
+            size_t line;
+            if (minimap.Render("##minimap", (ImTextureID)(intptr_t)minimapTexture, ImVec2(MinimapWidth, editorSize.y),
+                    view.TopLine(), view.VisibleLines(), document.LineCount(), line))
+                view.SetTopLine(line);
         }
-        UpdateCursorPosition();
+        if (view.Cursor() != lastCursor) cursorDirty = true;
+        if (cursorDirty) UpdateCursorPosition();
         ImGui::End();
+    }
 
+    void RenderStatusBar() {
+        PROFILE_SCOPE("Status bar");
+        ImGuiIO& io = ImGui::GetIO();
         ImGui::SetNextWindowPos(ImVec2(0, io.DisplaySize.y - 50));
         ImGui::SetNextWindowSize(ImVec2(io.DisplaySize.x, 50));
         ImGui::Begin("Status", nullptr, ImGuiWindowFlags_NoDecoration);
         std::string status = (currentFilePath.empty() ? "Untitled" : currentFilePath);
         if (hasUnsavedChanges) status += " *";
-        ImGui::Text("%s | Ln %d, Col %d | Words: %d | Chars: %d | Font: %.0fpx",
-            status.c_str(), currentLine, currentColumn, wordCount, charCount, fontSize);
+        ImGui::Text("%s | Ln %zu, Col %zu | Lines: %zu | Words: %zu | Chars: %zu | Font: %.0fpx",
+            status.c_str(), currentLine, currentColumn, document.LineCount(), wordCount, charCount, fontSize);
+        if (loader.Busy()) {
+            size_t total = loader.TotalBytes();
+            ImGui::SameLine();
+            if (total == 0) ImGui::Text("| Opening...");
+            else ImGui::Text("| Loading %.0f%% (%zu / %zu MiB)", 100.0 * loader.LoadedBytes() / total,
+                loader.LoadedBytes() >> 20, total >> 20);
+            ImGui::SameLine();
+            if (ImGui::SmallButton("Cancel")) CancelLoad();
+        }
+        else if (!loadReport.empty()) {
+            ImGui::SameLine();
+            ImGui::Text("| %s", loadReport.c_str());
+        }
+        ImGui::SameLine();
+        ImGui::TextDisabled("| Idle: %zu frames skipped", skippedFrames);
         ImGui::End();
+    }
+
+    void Render(const FontSet& fonts) {
+        ImGuiIO& io = ImGui::GetIO();
+        ImGui::PushFont(fonts.Ui());
+        PollLoader();
+        SyncHistory();
+
+        RenderTitleBar();
+        RenderMenu();
+
+        // Text fields have undo of their own; the document's is only for the view.
+        if (view.Focused() && io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_Z)) ApplyHistory(io.KeyShift ? 1 : -1);
+        if (view.Focused() && io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_Y)) ApplyHistory(1);
+        if (io.KeyCtrl && (ImGui::IsKeyPressed(ImGuiKey_Equal) || ImGui::IsKeyPressed(ImGuiKey_KeypadAdd))) ZoomIn();
+        if (io.KeyCtrl && (ImGui::IsKeyPressed(ImGuiKey_Minus) || ImGui::IsKeyPressed(ImGuiKey_KeypadSubtract))) ZoomOut();
+        if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_G)) {
+            goToLine = (int)std::min(currentLine, (size_t)INT_MAX);
+            showGoToLine = true;
+        }
+        if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_F)) {
+            if (io.KeyShift) OpenFindInFiles();
+            else OpenFind();
+        }
+        if (ImGui::IsKeyPressed(ImGuiKey_F3)) FindNext(io.KeyShift ? -1 : 1);
+        if (showFind && !loading) findCount.Poll(document, findRegex && !CompileFind() ? std::string() : findText, findRegex);
+        else findCount.Cancel();
+        if (showFind) RenderFind();
+        if (showFind && findRegex) view.SetHighlight(findText[0] && CompileFind() ? &findPattern : nullptr);
+        else view.SetHighlight(showFind ? findText : "");
+        if (fileSearch.Busy()) PollFileSearch();
+        if (showFindInFiles) RenderFindInFiles();
+        else if (fileSearch.Busy()) fileSearch.Cancel();
+        if (showDebugOverlay) RenderDebugOverlay();
+        if (showGoToLine) {
+            ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x * 0.5f - 150, 100), ImGuiCond_Appearing);
+            ImGui::Begin("Go to Line", &showGoToLine, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoSavedSettings);
+            if (ImGui::IsWindowAppearing()) ImGui::SetKeyboardFocusHere();
+            bool submitted = ImGui::InputInt("Line", &goToLine, 0, 0, ImGuiInputTextFlags_EnterReturnsTrue);
+            ImGui::SameLine();
+            if (ImGui::Button("Go") || submitted) {
+                GoToLine(goToLine);
+                showGoToLine = false;
+            }
+            ImGui::End();
+        }
+
+        RenderEditorWindow(fonts);
+        RenderStatusBar();
+        if (showProfiler) Profiler::RenderOverlay(&showProfiler);
+        Profiler::SetEnabled(showProfiler);
 
         ImGui::PopFont();
     }
 };
 
-int main() {
-    if (!glfwInit()) return -1;
-    GLFWwindow* window = glfwCreateWindow(1200, 800, "Text Editor", NULL, NULL);
-    if (!window) { glfwTerminate(); return -1; }
-    glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
-
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO& io = ImGui::GetIO();
-    io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
+void ApplyStyle() {
     ImGui::StyleColorsLight();
-
     ImGuiStyle& style = ImGui::GetStyle();
     style.WindowRounding = 12.0f;
     style.FrameRounding = 6.0f;
@@ -264,33 +958,191 @@ int main() {
     style.WindowPadding = ImVec2(20, 20);
     style.Colors[ImGuiCol_WindowBg] = ImVec4(0.95f, 0.95f, 0.96f, 1.0f);
     style.Colors[ImGuiCol_Text] = ImVec4(0.1f, 0.1f, 0.1f, 1.0f);
+}
+
+// --headless [scenario...] [--size-mb N] [--frames N]: runs TextEditor::Render at a fixed
+// 1200x800 with no window or GL backend, feeding each scenario's synthetic input, and
+// reports the CPU time of building each frame's draw lists. Scenarios: open (a generated
+// log file of N MiB), scroll, type, zoom; all of them by default, in that order, on the
+// same editor so that later ones run on the opened file.
+int RunHeadless(int argc, char** argv) {
+    static const char* const known[] = { "open", "scroll", "type", "zoom" };
+    std::vector<std::string> scenarios;
+    for (int i = 0; i < argc; i++) {
+        if (!strncmp(argv[i], "--", 2)) i++;
+        else scenarios.push_back(argv[i]);
+    }
+    if (scenarios.empty()) scenarios.assign(std::begin(known), std::end(known));
+    // All of them are checked before the open scenario writes its file.
+    for (const std::string& scenario : scenarios) {
+        if (std::find(std::begin(known), std::end(known), scenario) == std::end(known)) {
+            fprintf(stderr, "Unknown scenario %s\n", scenario.c_str());
+            return 1;
+        }
+    }
+    size_t sizeMiB = OptionValue(argc, argv, "--size-mb", 256);
+    int frames = (int)std::max<size_t>(1, OptionValue(argc, argv, "--frames", 600));
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.DisplaySize = ImVec2(1200, 800);
+    io.DeltaTime = 1.0f / 60.0f;
+    io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
+    ApplyStyle();
+    FontSet fonts;
+    fonts.Load(io.Fonts);
+
+    TextEditor editor;
+    editor.SetHeadless(true);
+    editor.UpdateStats();
+    std::string path = "texteditor-headless.txt";
+    ImVec2 center(io.DisplaySize.x * 0.5f, io.DisplaySize.y * 0.5f);
+
+    printf("%-8s %8s %10s %10s %10s %10s\n", "scenario", "frames", "mean ms", "p50 ms", "p99 ms", "max ms");
+    for (const std::string& scenario : scenarios) {
+        // Posts the scenario's input for a frame; false once the scenario is over.
+        std::function<bool(int)> input;
+        if (scenario == "open") {
+            printf("Generating %zu MiB test file %s...\n", sizeMiB, path.c_str());
+            if (!GenerateLogFile(path, sizeMiB)) {
+                fprintf(stderr, "Could not write %s\n", path.c_str());
+                ImGui::DestroyContext();
+                std::remove(path.c_str());
+                return 1;
+            }
+            editor.Open(path);
+            // Frames until the whole file is in, as the user would see them.
+            input = [&](int) { return editor.Loading(); };
+        }
+        else if (scenario == "scroll") {
+            input = [&](int frame) {
+                io.AddMousePosEvent(center.x, center.y);
+                io.AddMouseWheelEvent(0.0f, (frame / 100) % 2 ? 3.0f : -3.0f);
+                return frame < frames;
+            };
+        }
+        else if (scenario == "type") {
+            input = [&](int frame) {
+                // Click into the text first, then a character a frame and a new line every 40.
+                io.AddMousePosEvent(center.x, center.y);
+                if (frame < 2) io.AddMouseButtonEvent(ImGuiMouseButton_Left, frame == 0);
+                else if (frame % 40 == 0) io.AddKeyEvent(ImGuiKey_Enter, true);
+                else if (frame % 40 == 1) io.AddKeyEvent(ImGuiKey_Enter, false);
+                else io.AddInputCharacter('a' + frame % 26);
+                return frame < frames;
+            };
+        }
+        else {  // zoom
+            input = [&](int frame) {
+                // Ctrl+= ten times, then Ctrl+- ten times, one key press every other frame.
+                ImGuiKey key = (frame / 20) % 2 ? ImGuiKey_Minus : ImGuiKey_Equal;
+                io.AddKeyEvent(ImGuiMod_Ctrl, frame % 2 == 0);
+                io.AddKeyEvent(key, frame % 2 == 0);
+                return frame < frames;
+            };
+        }
+
+        std::vector<double> times;
+        for (int frame = 0; input(frame) && frame < 1000000; frame++) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            ImGui::NewFrame();
+            editor.Render(fonts);
+            ImGui::Render();
+            times.push_back(TextEditor::ElapsedMs(start));
+        }
+        if (times.empty()) times.push_back(0.0);
+        double total = 0;
+        for (double ms : times) total += ms;
+        std::sort(times.begin(), times.end());
+        auto percentile = [&](double p) { return times[std::min(times.size() - 1, (size_t)(p * times.size()))]; };
+        printf("%-8s %8zu %10.3f %10.3f %10.3f %10.3f\n", scenario.c_str(), times.size(), total / times.size(),
+            percentile(0.5), percentile(0.99), times.back());
+    }
+    ImGui::DestroyContext();
+    std::remove(path.c_str());
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::chrono::steady_clock::time_point launched = std::chrono::steady_clock::now();
+    size_t memoryBudget = PieceTable::Unlimited;
+    size_t undoBudget = UndoHistory::DefaultBudget;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--bench")) return RunBenchmark(argc - i - 1, argv + i + 1);
+        if (!strcmp(argv[i], "--headless")) return RunHeadless(argc - i - 1, argv + i + 1);
+        if (!strcmp(argv[i], "--memory-budget-mb") && i + 1 < argc) memoryBudget = strtoull(argv[++i], nullptr, 10) * 1024 * 1024;
+        if (!strcmp(argv[i], "--undo-budget-mb") && i + 1 < argc) undoBudget = strtoull(argv[++i], nullptr, 10) * 1024 * 1024;
+    }
+
+    if (!glfwInit()) return -1;
+    GLFWwindow* window = glfwCreateWindow(1200, 800, "Text Editor", NULL, NULL);
+    if (!window) { glfwTerminate(); return -1; }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(1);
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
+    ApplyStyle();
 
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 120");
 
-    ImFont* font = io.Fonts->AddFontFromFileTTF("../resources/Roboto-VariableFont_wdth,wght.ttf", 20.0f);
-    if (!font) font = io.Fonts->AddFontDefault();
+    FontSet fonts;
+    fonts.Load(io.Fonts);
 
     TextEditor editor;
+    editor.SetMemoryBudget(memoryBudget);
+    editor.SetUndoBudget(undoBudget);
     editor.UpdateStats();
 
+    FramePacer pacer;
+    if (const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor())) pacer.SetRefreshRate(mode->refreshRate);
+
+    bool firstFrame = true;
     while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
-
-        editor.Render(font);
-
-        ImGui::Render();
-        int display_w, display_h;
-        glfwGetFramebufferSize(window, &display_w, &display_h);
-        glViewport(0, 0, display_w, display_h);
-        glClearColor(0.95f, 0.95f, 0.96f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
-        glfwSwapBuffers(window);
+        // A minimized window has nothing to redraw until it is restored.
+        pacer.WaitForFrame(glfwGetWindowAttrib(window, GLFW_ICONIFIED) ? -1.0 : editor.IdleTimeout());
+        Profiler::BeginFrame();
+        {
+            PROFILE_SCOPE("NewFrame");
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+        }
+
+        editor.SetSkippedFrames(pacer.SkippedFrames());
+        editor.Render(fonts);
+
+        {
+            PROFILE_SCOPE("ImGui render");
+            ImGui::Render();
+        }
+        {
+            PROFILE_SCOPE("GL submit");
+            int display_w, display_h;
+            glfwGetFramebufferSize(window, &display_w, &display_h);
+            glViewport(0, 0, display_w, display_h);
+            glClearColor(0.95f, 0.95f, 0.96f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
+        {
+            PROFILE_SCOPE("Swap");
+            glfwSwapBuffers(window);
+        }
+        Profiler::EndFrame();
+
+        if (firstFrame) {
+            char report[128];
+            snprintf(report, sizeof(report), "First frame %.0f ms after launch; font atlas %s in %.0f ms",
+                TextEditor::ElapsedMs(launched), fonts.LoadedFromCache() ? "restored from cache" : "rasterized", fonts.LoadMs());
+            editor.SetStartupReport(report);
+            firstFrame = false;
+        }
     }
 
     ImGui_ImplOpenGL3_Shutdown();
@@ -2,6 +2,7 @@
 setlocal
 
 git submodule update --init --recursive
+git -C vendor\imgui checkout --quiet v1.91.8
 
 rd /s /q .\build
 mkdir build
@@ -0,0 +1,11 @@
+# Runs ImGui's binary_to_compressed_c on INPUT and writes the C array it prints to OUTPUT.
+# Usage: cmake -DTOOL=<tool> -DINPUT=<file> -DSYMBOL=<name> -DOUTPUT=<header> -P EmbedFile.cmake
+execute_process(
+    COMMAND "${TOOL}" "${INPUT}" "${SYMBOL}"
+    OUTPUT_FILE "${OUTPUT}"
+    RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+    file(REMOVE "${OUTPUT}")
+    message(FATAL_ERROR "Embedding ${INPUT} failed: ${result}")
+endif()